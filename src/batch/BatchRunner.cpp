@@ -0,0 +1,179 @@
+#include "BatchRunner.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+namespace dorito {
+  BatchRunner::Result BatchRunner::Run(const Job &job) {
+    Result result;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::ifstream probe(job.rom, std::ios::binary);
+    if (!probe.good())
+      return result;
+
+    probe.close();
+
+    /* Each job gets its own machine so jobs share nothing and can run on
+     * any thread. Machine is big enough (RAM, display planes, decode caches)
+     * that it goes on the heap rather than a worker's stack.
+     */
+    auto machine = CreateScope<Machine>();
+
+    machine->OnWarning([&result](const std::string &) {
+      result.warnings++;
+    });
+
+    machine->SetCompatProfile(job.profile);
+    machine->LoadRom(job.rom);
+
+    if (job.quirks) {
+      for (uint8_t quirk = 0; quirk < 8; quirk++) {
+        machine->SetQuirk(static_cast<Chip8::Quirk>(quirk), (*job.quirks >> quirk) & 1);
+      }
+    }
+
+    auto &cpu = machine->GetCpu();
+
+    cpu.Seed(job.seed);
+    cpu.Jit(job.jit);
+    cpu.Halted(false);
+
+    result.loaded = true;
+
+    for (uint32_t frame = 0; frame < job.frames; frame++) {
+      for (const auto &press: job.input) {
+        if (press.frame == frame)
+          cpu.SetKeyState(press.key, true);
+
+        // Same order as the app: the key goes up, then FX0A sees the release
+        if (press.frame + press.held == frame) {
+          cpu.SetKeyState(press.key, false);
+          cpu.KeyPressed(press.key);
+        }
+      }
+
+      machine->Tick(job.cyclesPerFrame);
+      machine->TickTimers();
+
+      if (cpu.Halted()) {
+        result.halted = true;
+        result.haltFrame = frame;
+        break;
+      }
+    }
+
+    result.frameHash = HashFrame(*machine);
+    result.cycles = cpu.Cycles();
+    result.waiting = cpu.Waiting();
+    result.stackUnderflows = machine->GetRam().StackUnderflows();
+    result.outOfRangeWrites = machine->GetRam().OutOfRangeWrites();
+
+    auto quirks = machine->Quirks();
+    for (size_t quirk = 0; quirk < quirks.size(); quirk++) {
+      if (quirks[quirk])
+        result.quirks |= static_cast<uint8_t>(1 << quirk);
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return result;
+  }
+
+  bool BatchRunner::ParseInput(const std::string &text, std::vector<KeyPress> &input) {
+    std::stringstream stream(text);
+    std::string entry;
+
+    while (std::getline(stream, entry, ',')) {
+      if (entry.empty())
+        continue;
+
+      KeyPress press{0, 0, 1};
+
+      try {
+        size_t first = entry.find(':');
+        if (first == std::string::npos)
+          return false;
+
+        size_t second = entry.find(':', first + 1);
+
+        press.frame = std::stoul(entry.substr(0, first));
+
+        auto key = std::stoul(entry.substr(first + 1, second - first - 1), nullptr, 16);
+        if (key > 0xF)
+          return false;
+
+        press.key = static_cast<uint8_t>(key);
+
+        if (second != std::string::npos)
+          press.held = std::stoul(entry.substr(second + 1));
+      } catch (const std::exception &) {
+        return false;
+      }
+
+      if (press.held == 0)
+        press.held = 1;
+
+      input.push_back(press);
+    }
+
+    return true;
+  }
+
+  bool BatchRunner::ParseProfile(const std::string &text, Machine::CompatProfile &profile) {
+    if (text == "vip" || text == "chip8") {
+      profile = Machine::CompatProfile::VIP;
+    } else if (text == "schip") {
+      profile = Machine::CompatProfile::SCHIP;
+    } else if (text == "xochip") {
+      profile = Machine::CompatProfile::XOChip;
+    } else {
+      return false;
+    }
+
+    return true;
+  }
+
+  std::string BatchRunner::ProfileName(Machine::CompatProfile profile) {
+    switch (profile) {
+      case Machine::CompatProfile::VIP:
+        return "vip";
+
+      case Machine::CompatProfile::SCHIP:
+        return "schip";
+
+      case Machine::CompatProfile::XOChip:
+      default:
+        return "xochip";
+    }
+  }
+
+  uint64_t BatchRunner::HashFrame(const Machine &machine) {
+    // FNV-1a over the resolution and every plane
+    uint64_t hash = 0xCBF29CE484222325;
+
+    auto mix = [&hash](uint8_t byte) {
+      hash ^= byte;
+      hash *= 0x100000001B3;
+    };
+
+    mix(machine.DisplayWidth());
+    mix(machine.DisplayHeight());
+
+    // Pixel by pixel, so hashes don't depend on how the planes are stored
+    auto loresGrid = machine.DisplayLoresGrid();
+
+    for (const auto &plane: machine.Buffers()) {
+      for (uint8_t y = 0; y < Display::Rows; y++) {
+        for (uint8_t x = 0; x < Display::Columns; x++) {
+          mix(Display::ScreenPixel(plane, loresGrid, x, y));
+        }
+      }
+    }
+
+    return hash;
+  }
+
+} // dorito
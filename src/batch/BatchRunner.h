@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "system/Machine.h"
+
+namespace dorito {
+
+  class BatchRunner {
+  public:
+    // Key press scripted against the frame counter
+    struct KeyPress {
+      uint32_t frame;
+      uint8_t key;
+      uint32_t held;
+    };
+
+    struct Job {
+      std::string rom;
+      Machine::CompatProfile profile = Machine::CompatProfile::XOChip;
+
+      // Overrides the profile's quirks, bit n is Chip8::Quirk n
+      std::optional<uint8_t> quirks;
+
+      uint16_t cyclesPerFrame = 1000;
+      uint32_t frames = 600;
+      uint32_t seed = 0;
+      bool jit = false;
+
+      std::vector<KeyPress> input;
+    };
+
+    struct Result {
+      bool loaded = false;
+      uint64_t frameHash = 0;
+      uint64_t cycles = 0;
+      uint8_t quirks = 0;
+
+      bool halted = false;
+      int64_t haltFrame = -1;
+      bool waiting = false;
+
+      uint32_t stackUnderflows = 0;
+      uint32_t outOfRangeWrites = 0;
+      uint32_t warnings = 0;
+
+      double seconds = 0.0;
+    };
+
+  public:
+    static Result Run(const Job &job);
+
+    // "frame:key[:held],..." with the key as a hex digit
+    static bool ParseInput(const std::string &text, std::vector<KeyPress> &input);
+
+    static bool ParseProfile(const std::string &text, Machine::CompatProfile &profile);
+
+    static std::string ProfileName(Machine::CompatProfile profile);
+
+  private:
+    static uint64_t HashFrame(const Machine &machine);
+  };
+
+} // dorito
@@ -0,0 +1,89 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace dorito {
+  WorkStealingPool::WorkStealingPool(size_t threads) : m_Threads(std::max<size_t>(threads, 1)) {
+    for (size_t n = 0; n < m_Threads; n++) {
+      m_Queues.push_back(CreateScope<Queue>());
+    }
+  }
+
+  void WorkStealingPool::Run(size_t jobs, const std::function<void(size_t job)> &work) {
+    size_t workers = std::min(m_Threads, std::max<size_t>(jobs, 1));
+
+    // Contiguous runs keep neighbouring jobs (usually the same ROM) on one thread
+    for (size_t worker = 0; worker < workers; worker++) {
+      size_t first = jobs * worker / workers;
+      size_t last = jobs * (worker + 1) / workers;
+
+      auto &queue = *m_Queues[worker];
+      std::lock_guard<std::mutex> guard(queue.lock);
+
+      for (size_t job = first; job < last; job++) {
+        queue.jobs.push_back(job);
+      }
+    }
+
+    auto loop = [&](size_t worker) {
+      /* Nothing gets queued once we start, so when every queue
+       * is empty there's nothing left to steal either.
+       */
+      while (true) {
+        auto job = Pop(worker);
+
+        if (!job)
+          job = Steal(worker);
+
+        if (!job)
+          break;
+
+        work(*job);
+      }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (size_t worker = 1; worker < workers; worker++) {
+      threads.emplace_back(loop, worker);
+    }
+
+    loop(0);
+
+    for (auto &thread: threads) {
+      thread.join();
+    }
+  }
+
+  std::optional<size_t> WorkStealingPool::Pop(size_t worker) {
+    auto &queue = *m_Queues[worker];
+    std::lock_guard<std::mutex> guard(queue.lock);
+
+    if (queue.jobs.empty())
+      return std::nullopt;
+
+    auto job = queue.jobs.back();
+    queue.jobs.pop_back();
+
+    return job;
+  }
+
+  std::optional<size_t> WorkStealingPool::Steal(size_t thief) {
+    for (size_t n = 1; n < m_Threads; n++) {
+      auto &queue = *m_Queues[(thief + n) % m_Threads];
+      std::lock_guard<std::mutex> guard(queue.lock);
+
+      if (queue.jobs.empty())
+        continue;
+
+      auto job = queue.jobs.front();
+      queue.jobs.pop_front();
+
+      return job;
+    }
+
+    return std::nullopt;
+  }
+
+} // dorito
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "common/common.h"
+
+namespace dorito {
+
+  /* Runs a fixed set of jobs over a group of threads. Jobs are dealt out
+   * up front in contiguous runs, each worker takes from the back of its
+   * own queue and steals from the front of the others once it runs dry,
+   * so a few slow ROMs don't leave the rest of the machine idle.
+   */
+  class WorkStealingPool {
+  public:
+    explicit WorkStealingPool(size_t threads);
+
+    void Run(size_t jobs, const std::function<void(size_t job)> &work);
+
+    [[nodiscard]] size_t Threads() const { return m_Threads; }
+
+  private:
+    struct Queue {
+      std::mutex lock;
+      std::deque<size_t> jobs;
+    };
+
+    std::optional<size_t> Pop(size_t worker);
+
+    std::optional<size_t> Steal(size_t thief);
+
+  private:
+    size_t m_Threads;
+
+    std::vector<Scope<Queue>> m_Queues;
+  };
+
+} // dorito
@@ -0,0 +1,268 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "batch/BatchRunner.h"
+#include "batch/WorkStealingPool.h"
+
+using dorito::BatchRunner;
+using dorito::Machine;
+
+namespace {
+  void Usage() {
+    fmt::print(stderr,
+               "usage: dorito_batch [options] rom...\n"
+               "\n"
+               "Runs every rom (times every profile and quirk set given) headless,\n"
+               "one emulator per job spread over all cores, and prints a CSV row per job.\n"
+               "\n"
+               "  -j N             worker threads (default: all cores)\n"
+               "  --jobs FILE      one job per line: rom [profile=P] [quirks=0xNN] [cycles=N]\n"
+               "                   [frames=N] [seed=N] [input=...], # starts a comment\n"
+               "  --profile P,...  vip, schip or xochip (default xochip)\n"
+               "  --quirks Q,...   quirk masks overriding the profile, bit n is Chip8::Quirk n\n"
+               "  --cycles N       cycles per frame (default 1000)\n"
+               "  --frames N       frames to run (default 600)\n"
+               "  --seed N         seed for the RND instruction (default 0)\n"
+               "  --input SPEC     frame:key[:held],... key presses, key in hex\n"
+               "  --jit            run with the recompiler where it's available\n");
+  }
+
+  bool SplitList(const std::string &text, std::vector<std::string> &items) {
+    std::stringstream stream(text);
+    std::string item;
+
+    while (std::getline(stream, item, ',')) {
+      if (!item.empty())
+        items.push_back(item);
+    }
+
+    return !items.empty();
+  }
+
+  bool ParseJobLine(const std::string &line, const BatchRunner::Job &defaults, BatchRunner::Job &job) {
+    std::stringstream stream(line);
+    std::string token;
+
+    job = defaults;
+    job.input.clear();
+
+    if (!(stream >> job.rom))
+      return false;
+
+    bool hasInput = false;
+
+    while (stream >> token) {
+      auto equals = token.find('=');
+      if (equals == std::string::npos)
+        return false;
+
+      auto key = token.substr(0, equals);
+      auto value = token.substr(equals + 1);
+
+      try {
+        if (key == "profile") {
+          if (!BatchRunner::ParseProfile(value, job.profile))
+            return false;
+        } else if (key == "quirks") {
+          job.quirks = static_cast<uint8_t>(std::stoul(value, nullptr, 0));
+        } else if (key == "cycles") {
+          job.cyclesPerFrame = static_cast<uint16_t>(std::stoul(value));
+        } else if (key == "frames") {
+          job.frames = std::stoul(value);
+        } else if (key == "seed") {
+          job.seed = std::stoul(value);
+        } else if (key == "input") {
+          if (!BatchRunner::ParseInput(value, job.input))
+            return false;
+
+          hasInput = true;
+        } else {
+          return false;
+        }
+      } catch (const std::exception &) {
+        return false;
+      }
+    }
+
+    if (!hasInput)
+      job.input = defaults.input;
+
+    return true;
+  }
+}
+
+int main(int argc, char **argv) {
+  BatchRunner::Job defaults;
+
+  std::vector<std::string> roms;
+  std::vector<std::string> profiles;
+  std::vector<std::string> quirkSets;
+  std::string jobsFile;
+
+  size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  try {
+    for (int n = 1; n < argc; n++) {
+      std::string arg = argv[n];
+
+      auto value = [&]() -> std::string {
+        if (n + 1 >= argc)
+          throw std::invalid_argument(arg);
+
+        return argv[++n];
+      };
+
+      if (arg == "-h" || arg == "--help") {
+        Usage();
+        return 0;
+      } else if (arg == "-j") {
+        threads = std::max<size_t>(std::stoul(value()), 1);
+      } else if (arg == "--jobs") {
+        jobsFile = value();
+      } else if (arg == "--profile") {
+        if (!SplitList(value(), profiles))
+          throw std::invalid_argument(arg);
+      } else if (arg == "--quirks") {
+        if (!SplitList(value(), quirkSets))
+          throw std::invalid_argument(arg);
+      } else if (arg == "--cycles") {
+        defaults.cyclesPerFrame = static_cast<uint16_t>(std::stoul(value()));
+      } else if (arg == "--frames") {
+        defaults.frames = std::stoul(value());
+      } else if (arg == "--seed") {
+        defaults.seed = std::stoul(value());
+      } else if (arg == "--input") {
+        if (!BatchRunner::ParseInput(value(), defaults.input))
+          throw std::invalid_argument(arg);
+      } else if (arg == "--jit") {
+        defaults.jit = true;
+      } else if (!arg.empty() && arg[0] == '-') {
+        throw std::invalid_argument(arg);
+      } else {
+        roms.push_back(arg);
+      }
+    }
+  } catch (const std::exception &e) {
+    fmt::print(stderr, "dorito_batch: bad argument {}\n\n", e.what());
+    Usage();
+    return 2;
+  }
+
+  if (profiles.empty())
+    profiles.push_back(BatchRunner::ProfileName(defaults.profile));
+
+  std::vector<BatchRunner::Job> jobs;
+
+  // Every rom on the command line runs once per profile and quirk set
+  for (const auto &rom: roms) {
+    for (const auto &profile: profiles) {
+      BatchRunner::Job job = defaults;
+      job.rom = rom;
+
+      if (!BatchRunner::ParseProfile(profile, job.profile)) {
+        fmt::print(stderr, "dorito_batch: unknown profile {}\n", profile);
+        return 2;
+      }
+
+      if (quirkSets.empty()) {
+        jobs.push_back(job);
+        continue;
+      }
+
+      for (const auto &quirks: quirkSets) {
+        try {
+          job.quirks = static_cast<uint8_t>(std::stoul(quirks, nullptr, 0));
+        } catch (const std::exception &) {
+          fmt::print(stderr, "dorito_batch: bad quirk mask {}\n", quirks);
+          return 2;
+        }
+
+        jobs.push_back(job);
+      }
+    }
+  }
+
+  if (!jobsFile.empty()) {
+    std::ifstream stream(jobsFile);
+
+    if (!stream.good()) {
+      fmt::print(stderr, "dorito_batch: unable to open {}\n", jobsFile);
+      return 2;
+    }
+
+    std::string line;
+    size_t lineNumber = 0;
+
+    while (std::getline(stream, line)) {
+      lineNumber++;
+
+      auto comment = line.find('#');
+      if (comment != std::string::npos)
+        line.erase(comment);
+
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+        continue;
+
+      BatchRunner::Job job;
+      if (!ParseJobLine(line, defaults, job)) {
+        fmt::print(stderr, "dorito_batch: {}:{}: bad job\n", jobsFile, lineNumber);
+        return 2;
+      }
+
+      jobs.push_back(job);
+    }
+  }
+
+  if (jobs.empty()) {
+    Usage();
+    return 2;
+  }
+
+  std::vector<BatchRunner::Result> results(jobs.size());
+
+  dorito::WorkStealingPool pool(threads);
+  pool.Run(jobs.size(), [&](size_t job) {
+    results[job] = BatchRunner::Run(jobs[job]);
+  });
+
+  fmt::print("rom,profile,quirks,cycles_per_frame,frames,seed,cycles,frame_hash,halted,halt_frame,waiting,"
+             "stack_underflows,out_of_range_writes,warnings,seconds\n");
+
+  int status = 0;
+
+  for (size_t n = 0; n < jobs.size(); n++) {
+    const auto &job = jobs[n];
+    const auto &result = results[n];
+
+    if (!result.loaded) {
+      fmt::print(stderr, "dorito_batch: unable to load {}\n", job.rom);
+      status = 1;
+      continue;
+    }
+
+    fmt::print("{},{},0x{:02X},{},{},{},{},{:016X},{},{},{},{},{},{},{:.3f}\n",
+               job.rom,
+               BatchRunner::ProfileName(job.profile),
+               result.quirks,
+               job.cyclesPerFrame,
+               job.frames,
+               job.seed,
+               result.cycles,
+               result.frameHash,
+               result.halted ? 1 : 0,
+               result.haltFrame,
+               result.waiting ? 1 : 0,
+               result.stackUnderflows,
+               result.outOfRangeWrites,
+               result.warnings,
+               result.seconds);
+  }
+
+  return status;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace dorito {
+
+  /* Bounded queue between exactly one producing and one consuming
+   * thread. Neither side ever takes a lock, Push fails when full and
+   * Pop fails when empty.
+   */
+  template<typename T, size_t Capacity>
+  class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+  public:
+    // Producer only, item is left untouched when the queue is full
+    bool Push(T &&item) {
+      auto tail = m_Tail.load(std::memory_order_relaxed);
+
+      if (tail - m_Head.load(std::memory_order_acquire) == Capacity)
+        return false;
+
+      m_Items[tail & (Capacity - 1)] = std::move(item);
+      m_Tail.store(tail + 1, std::memory_order_release);
+
+      return true;
+    }
+
+    // Consumer only
+    bool Pop(T &item) {
+      auto head = m_Head.load(std::memory_order_relaxed);
+
+      if (head == m_Tail.load(std::memory_order_acquire))
+        return false;
+
+      auto &slot = m_Items[head & (Capacity - 1)];
+      item = std::move(slot);
+      slot = T{};
+
+      m_Head.store(head + 1, std::memory_order_release);
+
+      return true;
+    }
+
+  private:
+    std::array<T, Capacity> m_Items{};
+
+    // Kept on separate cache lines so the two threads don't fight over them
+    alignas(64) std::atomic<size_t> m_Head = 0;
+    alignas(64) std::atomic<size_t> m_Tail = 0;
+  };
+
+} // dorito
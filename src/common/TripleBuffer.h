@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace dorito {
+
+  /* Hands the newest value from one thread to another without either
+   * side waiting. The writer fills Back() and publishes it, the reader
+   * gets whatever was published last from Front(). Values published in
+   * between are simply skipped.
+   */
+  template<typename T>
+  class TripleBuffer {
+  public:
+    // Writer only
+    T &Back() {
+      return m_Slots[m_Back];
+    }
+
+    // Writer only
+    void Publish() {
+      auto previous = m_Middle.exchange(m_Back | m_Fresh, std::memory_order_acq_rel);
+      m_Back = previous & m_Index;
+    }
+
+    // Reader only, stays valid until the next call
+    const T &Front() {
+      if (m_Middle.load(std::memory_order_relaxed) & m_Fresh) {
+        auto previous = m_Middle.exchange(m_Front, std::memory_order_acq_rel);
+        m_Front = previous & m_Index;
+      }
+
+      return m_Slots[m_Front];
+    }
+
+  private:
+    static constexpr uint8_t m_Index = 0x3;
+    static constexpr uint8_t m_Fresh = 0x4;
+
+    std::array<T, 3> m_Slots{};
+
+    uint8_t m_Back = 0;
+    uint8_t m_Front = 1;
+
+    // The slot between the two, with m_Fresh set when the reader hasn't seen it
+    std::atomic<uint8_t> m_Middle = 2;
+  };
+
+} // dorito
@@ -115,11 +115,6 @@ namespace dorito {
         Events::WantQuit,
         &Dorito::HandleWantQuit
     >(this);
-
-    EventManager::Get().Attach<
-        Events::VBlank,
-        &Dorito::HandleVBlank
-    >(this);
   }
 
   Dorito::~Dorito() {
@@ -197,19 +192,4 @@ namespace dorito {
     m_Running = false;
   }
 
-  void Dorito::HandleVBlank(const Events::VBlank &) {
-    BeginTextureMode(m_RenderTexture);
-    ClearBackground(m_DefaultBackground);
-
-    if (!m_GameLayers)
-      return;
-
-    for (auto layer: *m_GameLayers) {
-      if (layer->RenderTarget()) {
-        layer->Render();
-      }
-    }
-    EndTextureMode();
-  }
-
 } // dorito
\ No newline at end of file
@@ -108,8 +108,6 @@ namespace dorito {
 
     void HandleWantQuit(const Events::WantQuit &event);
 
-    void HandleVBlank(const Events::VBlank &event);
-
   private:
     GameLayerStack *m_GameLayers = nullptr;
 
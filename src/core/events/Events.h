@@ -116,14 +116,37 @@ namespace dorito::Events {
     StepCPU() : Event() {}
   };
 
+  // Quick save slots, kept next to the ROM
+  struct SaveStateSlot : public Event {
+    SaveStateSlot(uint8_t slot = 1) : Event(), slot(slot) {}
+
+    uint8_t slot;
+  };
+
+  struct LoadStateSlot : public Event {
+    LoadStateSlot(uint8_t slot = 1) : Event(), slot(slot) {}
+
+    uint8_t slot;
+  };
+
+  struct StepBackCPU : public Event {
+    StepBackCPU() : Event() {}
+  };
+
+  // Runs the machine backwards a frame at a time for as long as it's set
+  struct RewindCPU : public Event {
+    RewindCPU(bool isRewinding = true) : Event(), isRewinding(isRewinding) {}
+
+    bool isRewinding;
+  };
+
   struct ExecuteUntil : public Event {
-    ExecuteUntil(uint16_t addr) : Event(), addr(addr) {}
+    ExecuteUntil(uint16_t addr, uint64_t budget = 100'000'000) : Event(), addr(addr), budget(budget) {}
 
     uint16_t addr;
-  };
 
-  struct VBlank : public Event {
-    VBlank() : Event() {}
+    // Most instructions to run before giving up
+    uint64_t budget;
   };
 
   struct HandleAudio : public Event {
@@ -176,6 +199,30 @@ namespace dorito::Events {
     XOCompat() : Event() {}
   };
 
+  struct SetThreaded : public Event {
+    explicit SetThreaded(bool isSet) : Event(), isSet(isSet) {}
+
+    bool isSet;
+  };
+
+  struct SetMaxSpeed : public Event {
+    explicit SetMaxSpeed(bool isSet) : Event(), isSet(isSet) {}
+
+    bool isSet;
+  };
+
+  struct SetJit : public Event {
+    explicit SetJit(bool isSet) : Event(), isSet(isSet) {}
+
+    bool isSet;
+  };
+
+  struct SetJitChecked : public Event {
+    explicit SetJitChecked(bool isSet) : Event(), isSet(isSet) {}
+
+    bool isSet;
+  };
+
   struct SetQuirk : public Event {
     SetQuirk(Chip8::Quirk quirk, bool value) : Event(), quirk(quirk), value(value) {}
 
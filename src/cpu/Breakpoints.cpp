@@ -0,0 +1,430 @@
+#include "Breakpoints.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include <fmt/format.h>
+
+namespace dorito {
+  std::string BreakpointCondition::Compile(const std::string &source) {
+    /* Plain recursive descent, lowest precedence first:
+     *   or      := and ('||' and)*
+     *   and     := compare ('&&' compare)*
+     *   compare := sum (('==' | '!=' | '<' | '<=' | '>' | '>=') sum)?
+     *   sum     := unary (('+' | '-' | '&' | '|') unary)*
+     *   unary   := '!' unary | '(' or ')' | operand
+     */
+    struct Parser {
+      const std::string &source;
+      std::vector<Instruction> code{};
+      size_t pos = 0;
+      uint8_t depth = 0;
+      uint8_t nesting = 0;
+      std::string error{};
+
+      void SkipSpace() {
+        while (pos < source.size() && std::isspace(static_cast<unsigned char>(source[pos])))
+          pos++;
+      }
+
+      bool Accept(const char *token) {
+        SkipSpace();
+
+        auto length = std::char_traits<char>::length(token);
+        if (source.compare(pos, length, token) != 0)
+          return false;
+
+        // Don't read the start of && as & or of <= as <
+        if (length == 1 && pos + 1 < source.size()) {
+          char next = source[pos + 1];
+
+          if ((token[0] == '&' && next == '&') || (token[0] == '|' && next == '|') ||
+              ((token[0] == '<' || token[0] == '>' || token[0] == '!') && next == '='))
+            return false;
+        }
+
+        pos += length;
+        return true;
+      }
+
+      void Fail(const std::string &message) {
+        if (error.empty())
+          error = fmt::format("{} at column {}", message, pos + 1);
+      }
+
+      void Emit(Code op, uint16_t value = 0) {
+        switch (op) {
+          case Code::Push:
+          case Code::Load:
+            if (++depth > m_MaxDepth)
+              Fail("Too complex");
+            break;
+
+          case Code::Not:
+            break;
+
+          default:
+            depth--;
+            break;
+        }
+
+        code.push_back({op, value});
+      }
+
+      void Operand() {
+        SkipSpace();
+
+        size_t start = pos;
+        while (pos < source.size() && std::isalnum(static_cast<unsigned char>(source[pos])))
+          pos++;
+
+        auto word = source.substr(start, pos - start);
+        std::transform(word.begin(), word.end(), word.begin(), [](unsigned char c) {
+          return std::tolower(c);
+        });
+
+        if (word.empty()) {
+          pos = start;
+          Fail(pos < source.size() ? fmt::format("Unexpected '{}'", source[pos]) : "Expected a value");
+          return;
+        }
+
+        if (word == "i") {
+          Emit(Code::Load, I);
+        } else if (word == "pc") {
+          Emit(Code::Load, PC);
+        } else if (word == "dt") {
+          Emit(Code::Load, DT);
+        } else if (word == "st") {
+          Emit(Code::Load, ST);
+        } else if (word.size() == 2 && word[0] == 'v' && std::isxdigit(static_cast<unsigned char>(word[1]))) {
+          Emit(Code::Load, static_cast<uint16_t>(std::stoi(word.substr(1), nullptr, 16)));
+        } else if (std::isdigit(static_cast<unsigned char>(word[0]))) {
+          int base = 10;
+          auto digits = word;
+
+          if (word.starts_with("0x")) {
+            base = 16;
+            digits = word.substr(2);
+          } else if (word.starts_with("0b")) {
+            base = 2;
+            digits = word.substr(2);
+          }
+
+          size_t used = 0;
+          unsigned long value = 0;
+
+          try {
+            value = std::stoul(digits, &used, base);
+          } catch (const std::exception &) {
+            used = 0;
+          }
+
+          if (digits.empty() || used != digits.size() || value > 0xFFFF) {
+            pos = start;
+            Fail(fmt::format("Bad number '{}'", word));
+            return;
+          }
+
+          Emit(Code::Push, static_cast<uint16_t>(value));
+        } else {
+          pos = start;
+          Fail(fmt::format("Unknown name '{}'", word));
+        }
+      }
+
+      void Unary() {
+        // Cap how deep ( and ! nest at the size of the stack, so a long run of either cannot overflow the real one
+        if (nesting > m_MaxDepth) {
+          Fail("Nested too deep");
+          return;
+        }
+
+        nesting++;
+
+        if (Accept("!")) {
+          Unary();
+          Emit(Code::Not);
+        } else if (Accept("(")) {
+          Or();
+
+          if (!Accept(")"))
+            Fail("Expected ')'");
+        } else {
+          Operand();
+        }
+
+        nesting--;
+      }
+
+      void Sum() {
+        Unary();
+
+        while (error.empty()) {
+          if (Accept("+")) {
+            Unary();
+            Emit(Code::Add);
+          } else if (Accept("-")) {
+            Unary();
+            Emit(Code::Subtract);
+          } else if (Accept("&")) {
+            Unary();
+            Emit(Code::BitAnd);
+          } else if (Accept("|")) {
+            Unary();
+            Emit(Code::BitOr);
+          } else {
+            break;
+          }
+        }
+      }
+
+      void Compare() {
+        Sum();
+
+        static const std::pair<const char *, Code> comparisons[] = {
+            {"==", Code::Equal},
+            {"!=", Code::NotEqual},
+            {"<=", Code::LessEqual},
+            {">=", Code::GreaterEqual},
+            {"<",  Code::Less},
+            {">",  Code::Greater}
+        };
+
+        for (const auto &[token, op]: comparisons) {
+          if (Accept(token)) {
+            Sum();
+            Emit(op);
+            break;
+          }
+        }
+      }
+
+      void And() {
+        Compare();
+
+        while (error.empty() && Accept("&&")) {
+          Compare();
+          Emit(Code::And);
+        }
+      }
+
+      void Or() {
+        And();
+
+        while (error.empty() && Accept("||")) {
+          And();
+          Emit(Code::Or);
+        }
+      }
+    };
+
+    Parser parser{source};
+
+    parser.SkipSpace();
+    if (parser.pos < source.size()) {
+      parser.Or();
+
+      parser.SkipSpace();
+      if (parser.pos < source.size())
+        parser.Fail(fmt::format("Unexpected '{}'", source[parser.pos]));
+    }
+
+    if (!parser.error.empty())
+      return parser.error;
+
+    m_Code = std::move(parser.code);
+
+    return {};
+  }
+
+  bool BreakpointCondition::Evaluate(const State &state) const {
+    if (m_Code.empty())
+      return true;
+
+    int32_t stack[m_MaxDepth];
+    uint8_t top = 0;
+
+    for (const auto &instruction: m_Code) {
+      switch (instruction.code) {
+        case Code::Push:
+          stack[top++] = instruction.value;
+          continue;
+
+        case Code::Load:
+          stack[top++] = state[instruction.value];
+          continue;
+
+        case Code::Not:
+          stack[top - 1] = !stack[top - 1];
+          continue;
+
+        default:
+          break;
+      }
+
+      int32_t b = stack[--top];
+      int32_t &a = stack[top - 1];
+
+      switch (instruction.code) {
+        case Code::Add:
+          a = a + b;
+          break;
+        case Code::Subtract:
+          a = a - b;
+          break;
+        case Code::BitAnd:
+          a = a & b;
+          break;
+        case Code::BitOr:
+          a = a | b;
+          break;
+        case Code::Equal:
+          a = a == b;
+          break;
+        case Code::NotEqual:
+          a = a != b;
+          break;
+        case Code::Less:
+          a = a < b;
+          break;
+        case Code::LessEqual:
+          a = a <= b;
+          break;
+        case Code::Greater:
+          a = a > b;
+          break;
+        case Code::GreaterEqual:
+          a = a >= b;
+          break;
+        case Code::And:
+          a = a && b;
+          break;
+        case Code::Or:
+          a = a || b;
+          break;
+        default:
+          break;
+      }
+    }
+
+    return stack[0] != 0;
+  }
+
+  bool Breakpoints::Hit(uint16_t addr, const BreakpointCondition::State &state) {
+    auto it = m_ByAddress.find(addr);
+
+    if (it == m_ByAddress.end())
+      return false;
+
+    bool stop = false;
+
+    for (auto index: it->second) {
+      auto &breakpoint = m_List[index];
+
+      if (!m_Conditions[index].Evaluate(state))
+        continue;
+
+      breakpoint.hits++;
+
+      if (breakpoint.hits >= breakpoint.hitTarget)
+        stop = true;
+    }
+
+    return stop;
+  }
+
+  std::string Breakpoints::Add(const Breakpoint &breakpoint) {
+    BreakpointCondition condition;
+
+    auto error = condition.Compile(breakpoint.condition);
+    if (!error.empty())
+      return error;
+
+    m_List.push_back(breakpoint);
+    m_Conditions.push_back(std::move(condition));
+
+    Rearm();
+
+    return {};
+  }
+
+  void Breakpoints::Toggle(const std::string &label) {
+    for (auto &breakpoint: m_List) {
+      if (breakpoint.label == label) {
+        breakpoint.enabled = !breakpoint.enabled;
+        break;
+      }
+    }
+
+    Rearm();
+  }
+
+  void Breakpoints::Remove(const std::string &label) {
+    for (size_t index = 0; index < m_List.size();) {
+      if (m_List[index].label == label) {
+        m_List.erase(m_List.begin() + static_cast<ptrdiff_t>(index));
+        m_Conditions.erase(m_Conditions.begin() + static_cast<ptrdiff_t>(index));
+      } else {
+        index++;
+      }
+    }
+
+    Rearm();
+  }
+
+  void Breakpoints::Clear() {
+    m_List.clear();
+    m_Conditions.clear();
+
+    Rearm();
+  }
+
+  std::string Breakpoints::SetCondition(const std::string &label, const std::string &condition, uint32_t hitTarget) {
+    BreakpointCondition compiled;
+
+    auto error = compiled.Compile(condition);
+    if (!error.empty())
+      return error;
+
+    for (size_t index = 0; index < m_List.size(); index++) {
+      auto &breakpoint = m_List[index];
+
+      if (breakpoint.label != label)
+        continue;
+
+      // A new condition starts counting from scratch
+      if (breakpoint.condition != condition || breakpoint.hitTarget != hitTarget)
+        breakpoint.hits = 0;
+
+      breakpoint.condition = condition;
+      breakpoint.hitTarget = hitTarget;
+      m_Conditions[index] = compiled;
+    }
+
+    return {};
+  }
+
+  void Breakpoints::Rearm() {
+    m_ByAddress.clear();
+    m_Armed.fill(0);
+    m_ArmedCount = 0;
+
+    for (size_t index = 0; index < m_List.size(); index++) {
+      const auto &breakpoint = m_List[index];
+
+      if (!breakpoint.enabled)
+        continue;
+
+      auto &atAddress = m_ByAddress[breakpoint.addr];
+
+      if (atAddress.empty()) {
+        m_Armed[breakpoint.addr >> 6] |= uint64_t{1} << (breakpoint.addr & 63);
+        m_ArmedCount++;
+      }
+
+      atAddress.push_back(index);
+    }
+  }
+
+} // dorito
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dorito {
+
+  struct Breakpoint {
+    std::string label;
+    uint16_t addr;
+    bool enabled;
+
+    // Optional, e.g. "v3 == 0x10 && i > 0x400". Empty always holds
+    std::string condition{};
+
+    // Stops once the condition has held this many times, 0 stops every time
+    uint32_t hitTarget = 0;
+    uint32_t hits = 0;
+  };
+
+  /* A breakpoint condition compiled to a little stack machine so
+   * checking it doesn't mean walking the source again. It can read
+   * v0-vF, i, pc, dt and st, compare them and combine the results
+   * with &&, ||, !, &, |, + and -.
+   */
+  class BreakpointCondition {
+  public:
+    // Slots of the machine state handed to Evaluate, v0-vF come first
+    static constexpr uint8_t I = 16;
+    static constexpr uint8_t PC = 17;
+    static constexpr uint8_t DT = 18;
+    static constexpr uint8_t ST = 19;
+    static constexpr uint8_t StateSize = 20;
+
+    using State = std::array<uint16_t, StateSize>;
+
+  public:
+    // Empty when it compiled, otherwise what is wrong with source
+    std::string Compile(const std::string &source);
+
+    [[nodiscard]] bool Evaluate(const State &state) const;
+
+  private:
+    enum class Code : uint8_t {
+      Push,
+      Load,
+      Not,
+      Add,
+      Subtract,
+      BitAnd,
+      BitOr,
+      Equal,
+      NotEqual,
+      Less,
+      LessEqual,
+      Greater,
+      GreaterEqual,
+      And,
+      Or
+    };
+
+    struct Instruction {
+      Code code;
+      uint16_t value;
+    };
+
+    static constexpr uint8_t m_MaxDepth = 32;
+
+    std::vector<Instruction> m_Code;
+  };
+
+  /* Every breakpoint plus a bit per address saying whether any enabled
+   * one sits there. The CPU only ever tests the bit, the list and the
+   * conditions behind it are looked at once it is set.
+   */
+  class Breakpoints {
+  public:
+    [[nodiscard]] bool Armed(uint16_t addr) const {
+      return (m_Armed[addr >> 6] >> (addr & 63)) & 1;
+    }
+
+    [[nodiscard]] bool AnyArmed() const { return m_ArmedCount > 0; }
+
+    // Counts the hit and says whether to stop, only called once Armed(addr)
+    bool Hit(uint16_t addr, const BreakpointCondition::State &state);
+
+    // Empty when added, otherwise why the condition didn't compile
+    std::string Add(const Breakpoint &breakpoint);
+
+    void Toggle(const std::string &label);
+
+    void Remove(const std::string &label);
+
+    void Clear();
+
+    // Empty when set, otherwise why the condition didn't compile and nothing changed
+    std::string SetCondition(const std::string &label, const std::string &condition, uint32_t hitTarget);
+
+    [[nodiscard]] const std::vector<Breakpoint> &List() const { return m_List; }
+
+  private:
+    void Rearm();
+
+  private:
+    std::vector<Breakpoint> m_List;
+    std::vector<BreakpointCondition> m_Conditions;
+
+    // Indices into m_List of the enabled breakpoints at each armed address
+    std::unordered_map<uint16_t, std::vector<size_t>> m_ByAddress;
+
+    std::array<uint64_t, 0x10000 / 64> m_Armed{};
+    uint32_t m_ArmedCount = 0;
+  };
+
+} // dorito
@@ -1,15 +1,16 @@
 #include "Chip8.h"
 
-#include <regex>
+#include <cstring>
 #include <fstream>
 
 #include <fmt/format.h>
-#include <spdlog/spdlog.h>
+#include <fmt/compile.h>
 
-#include "system/Bus.h"
+#include "system/Machine.h"
+#include "Recompiler.h"
 
 namespace dorito {
-  Chip8::Chip8() {
+  Chip8::Chip8(Machine &machine) : m_Machine(machine) {
     Reset();
     m_Instructions = {
         {
@@ -17,7 +18,7 @@ namespace dorito {
             {0x0,
                 "0NNN", "nop",
                 1, {OperandType::Number12bit},
-                &Chip8::ProcUnimplemented
+                Op::Unimplemented
             }
         },
         {
@@ -25,7 +26,7 @@ namespace dorito {
             {0xC0,
                 "00CN", "scroll-down N",
                 1, {OperandType::Number4bit},
-                &Chip8::ProcScrollDown
+                Op::ScrollDown
             }
         },
         {
@@ -33,7 +34,7 @@ namespace dorito {
             {0xD0,
                 "00DN", "scroll-up N",
                 1, {OperandType::Number4bit},
-                &Chip8::ProcScrollUp
+                Op::ScrollUp
             }
         },
         {
@@ -41,7 +42,7 @@ namespace dorito {
             {0xE0,
                 "00E0", "clear",
                 0, {},
-                &Chip8::ProcClearScreen
+                Op::ClearScreen
             }
         },
         {
@@ -49,7 +50,7 @@ namespace dorito {
             {0xEE,
                 "00EE", "return",
                 0, {},
-                &Chip8::ProcReturn
+                Op::Return
             }
         },
         {
@@ -57,7 +58,7 @@ namespace dorito {
             {0xFB,
                 "00FB", "scroll-right",
                 0, {},
-                &Chip8::ProcScrollRight
+                Op::ScrollRight
             }
         },
         {
@@ -65,7 +66,7 @@ namespace dorito {
             {0xFC,
                 "00FC", "scroll-left",
                 0, {},
-                &Chip8::ProcScrollLeft
+                Op::ScrollLeft
             }
         },
         {
@@ -73,7 +74,7 @@ namespace dorito {
             {0xFD,
                 "00FD", "exit",
                 0, {},
-                &Chip8::ProcExit
+                Op::Exit
             }
         },
         {
@@ -81,7 +82,7 @@ namespace dorito {
             {0xFE,
                 "00FE", "lores",
                 0, {},
-                &Chip8::ProcLores
+                Op::Lores
             }
         },
         {
@@ -89,7 +90,7 @@ namespace dorito {
             {0xFF,
                 "00FF", "hires",
                 0, {},
-                &Chip8::ProcHires
+                Op::Hires
             }
         },
         {
@@ -97,7 +98,7 @@ namespace dorito {
             {0x1000,
                 "1NNN", "jump NNN",
                 1, {OperandType::Number12bit},
-                &Chip8::ProcJump
+                Op::Jump
             }
         },
         {
@@ -105,7 +106,7 @@ namespace dorito {
             {0x2000,
                 "2NNN", "call NNN",
                 1, {OperandType::Number12bit},
-                &Chip8::ProcCall
+                Op::Call
             }
         },
         {
@@ -113,7 +114,7 @@ namespace dorito {
             {0x3000,
                 "3XNN", "skip vX == NN",
                 2, {OperandType::Register, OperandType::Number8bit},
-                &Chip8::ProcSkipEqualsLiteral
+                Op::SkipEqualsLiteral
             }
         },
         {
@@ -121,7 +122,7 @@ namespace dorito {
             {0x4000,
                 "4XNN", "skip vX != NN",
                 2, {OperandType::Register, OperandType::Number8bit},
-                &Chip8::ProcSkipNotEqualsLiteral
+                Op::SkipNotEqualsLiteral
             }
         },
         {
@@ -129,7 +130,7 @@ namespace dorito {
             {0x5000,
                 "5XY0", "skip vX == vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcSkipRegEqualsReg
+                Op::SkipRegEqualsReg
             }
         },
         {
@@ -137,7 +138,7 @@ namespace dorito {
             {0x5002,
                 "5XY2", "save vX - vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcRegisterSave
+                Op::RegisterSave
             }
         },
         {
@@ -145,7 +146,7 @@ namespace dorito {
             {0x5003,
                 "5XY3", "load vX - vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcRegisterLoad
+                Op::RegisterLoad
             }
         },
         {
@@ -154,7 +155,7 @@ namespace dorito {
                 "6XNN", "vX := NN",
 
                 2, {OperandType::Register, OperandType::Number8bit},
-                &Chip8::ProcLoadLiteral
+                Op::LoadLiteral
             }
         },
         {
@@ -162,7 +163,7 @@ namespace dorito {
             {0x7000,
                 "7XNN", "vX += NN",
                 2, {OperandType::Register, OperandType::Number8bit},
-                &Chip8::ProcAddLiteral
+                Op::AddLiteral
             }
         },
         {
@@ -170,7 +171,7 @@ namespace dorito {
             {0x8000,
                 "8XY0", "vX := vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcLoadRegister
+                Op::LoadRegister
             }
         },
         {
@@ -178,7 +179,7 @@ namespace dorito {
             {0x8001,
                 "8XY1", "vX |= vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcORReg
+                Op::ORReg
             }
         },
         {
@@ -186,7 +187,7 @@ namespace dorito {
             {0x8002,
                 "8XY2", "vX &= vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcANDReg
+                Op::ANDReg
             }
         },
         {
@@ -194,7 +195,7 @@ namespace dorito {
             {0x8003,
                 "8XY3", "vX ^= vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcXORReg
+                Op::XORReg
             }
         },
         {
@@ -202,7 +203,7 @@ namespace dorito {
             {0x8004,
                 "8XY4", "vX += vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcAdd
+                Op::Add
             }
         },
         {
@@ -210,7 +211,7 @@ namespace dorito {
             {0x8005,
                 "8XY5", "vX -= vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcSubtractYFromX
+                Op::SubtractYFromX
             }
         },
         {
@@ -218,7 +219,7 @@ namespace dorito {
             {0x8006,
                 "8XY6", "vX := vY >> 1",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcShiftRight
+                Op::ShiftRight
             }
         },
         {
@@ -226,7 +227,7 @@ namespace dorito {
             {0x8007,
                 "8XY7", "vX =- vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcSubtractXFromY
+                Op::SubtractXFromY
             }
         },
         {
@@ -234,7 +235,7 @@ namespace dorito {
             {0x800E,
                 "8XYE", "vX := vY << 1",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcShiftLeft
+                Op::ShiftLeft
             }
         },
         {
@@ -242,7 +243,7 @@ namespace dorito {
             {0x9000,
                 "9XY0", "skip vX != vY",
                 2, {OperandType::Register, OperandType::Register},
-                &Chip8::ProcSkipRegNotEqualReg
+                Op::SkipRegNotEqualReg
             }
         },
         {
@@ -250,7 +251,7 @@ namespace dorito {
             {0xA000,
                 "ANNN", "i := NNN",
                 1, {OperandType::Number12bit},
-                &Chip8::ProcLoadILiteral
+                Op::LoadILiteral
             }
         },
         {
@@ -258,7 +259,7 @@ namespace dorito {
             {0xB000,
                 "BNNN", "jump v0 + NNN",
                 1, {OperandType::Number12bit},
-                &Chip8::ProcJumpRelative
+                Op::JumpRelative
             }
         },
         {
@@ -266,7 +267,7 @@ namespace dorito {
             {0xC000,
                 "CXNN", "vX := random & NN",
                 2, {OperandType::Register, OperandType::Number8bit},
-                &Chip8::ProcRandom
+                Op::Random
             }
         },
         {
@@ -274,7 +275,7 @@ namespace dorito {
             {0xD000,
                 "DXYN", "sprite vX vY N",
                 3, {OperandType::Register, OperandType::Register, OperandType::Number4bit},
-                &Chip8::ProcDrawSprite
+                Op::DrawSprite
             }
         },
         {
@@ -282,7 +283,7 @@ namespace dorito {
             {0xE09E,
                 "EX9E", "skip vX == key pressed",
                 1, {OperandType::Register},
-                &Chip8::ProcSkipKeyPressed
+                Op::SkipKeyPressed
             }
         },
         {
@@ -290,7 +291,7 @@ namespace dorito {
             {0xE0A1,
                 "EXA1", "skip vX != key pressed",
                 1, {OperandType::Register},
-                &Chip8::ProcSkipKeyNotPressed
+                Op::SkipKeyNotPressed
             }
         },
         {
@@ -298,7 +299,7 @@ namespace dorito {
             {0xF000,
                 "F000", "i := long NNNN",
                 1, {OperandType::Number16bit},
-                &Chip8::ProcLoadIExtended
+                Op::LoadIExtended
             }
         },
         {
@@ -306,7 +307,7 @@ namespace dorito {
             {0xF001,
                 "FN01", "plane N",
                 1, {OperandType::Number4bit},
-                &Chip8::ProcPlane
+                Op::Plane
             }
         },
         {
@@ -314,7 +315,7 @@ namespace dorito {
             {0xF002,
                 "F002", "audio",
                 0, {},
-                &Chip8::ProcAudio
+                Op::Audio
             }
         },
         {
@@ -322,7 +323,7 @@ namespace dorito {
             {0xF007,
                 "FX07", "vX := delay",
                 1, {OperandType::Register},
-                &Chip8::ProcLoadDelayToReg
+                Op::LoadDelayToReg
             }
         },
         {
@@ -330,7 +331,7 @@ namespace dorito {
             {0xF00A,
                 "FX0A", "vX := key",
                 1, {OperandType::Register},
-                &Chip8::ProcLoadKeypressToReg
+                Op::LoadKeypressToReg
             }
         },
         {
@@ -338,7 +339,7 @@ namespace dorito {
             {0xF015,
                 "FX15", "delay := vX",
                 1, {OperandType::Register},
-                &Chip8::ProcLoadRegToDelay
+                Op::LoadRegToDelay
             }
         },
         {
@@ -346,7 +347,7 @@ namespace dorito {
             {0xF018,
                 "FX18", "buzzer := vX",
                 1, {OperandType::Register},
-                &Chip8::ProcLoadRegToBuzzer
+                Op::LoadRegToBuzzer
             }
         },
         {
@@ -354,7 +355,7 @@ namespace dorito {
             {0xF01E,
                 "FX1E", "i += vX",
                 1, {OperandType::Register},
-                &Chip8::ProcAddIWithReg
+                Op::AddIWithReg
             }
         },
         {
@@ -362,7 +363,7 @@ namespace dorito {
             {0xF029,
                 "FX29", "i := hex vX",
                 1, {OperandType::Register},
-                &Chip8::ProcLoadISpriteAddr
+                Op::LoadISpriteAddr
             }
         },
         {
@@ -370,7 +371,7 @@ namespace dorito {
             {0xF030,
                 "FX30", "i := bighex vX",
                 1, {OperandType::Register},
-                &Chip8::ProcLoadIBigSpriteAddr
+                Op::LoadIBigSpriteAddr
             }
         },
         {
@@ -378,7 +379,7 @@ namespace dorito {
             {0xF033,
                 "FX33", "bcd vX",
                 1, {OperandType::Register},
-                &Chip8::ProcLoadBCD
+                Op::LoadBCD
             }
         },
         {
@@ -386,7 +387,7 @@ namespace dorito {
             {0xF03A,
                 "FX3A", "pitch := vX",
                 1, {OperandType::Register},
-                &Chip8::ProcPitch
+                Op::Pitch
             }
         },
         {
@@ -394,7 +395,7 @@ namespace dorito {
             {0xF055,
                 "FX55", "save vX",
                 1, {OperandType::Register},
-                &Chip8::ProcRegisterSaveIncrement
+                Op::RegisterSaveIncrement
             }
         },
         {
@@ -402,7 +403,7 @@ namespace dorito {
             {0xF065,
                 "FX65", "load vX",
                 1, {OperandType::Register},
-                &Chip8::ProcRegisterLoadIncrement
+                Op::RegisterLoadIncrement
             }
         },
         {
@@ -410,7 +411,7 @@ namespace dorito {
             {0xF075,
                 "FX75", "saveflags vX",
                 1, {OperandType::Register},
-                &Chip8::ProcSaveFlags
+                Op::SaveFlags
             }
         },
         {
@@ -418,7 +419,7 @@ namespace dorito {
             {0xF085,
                 "FX85", "loadflags vX",
                 1, {OperandType::Register},
-                &Chip8::ProcLoadFlags
+                Op::LoadFlags
             }
         },
         {
@@ -426,10 +427,95 @@ namespace dorito {
             {0xFFFF,
                 "FFFF", "invalid",
                 0, {},
-                &Chip8::ProcUnimplemented
+                Op::Unimplemented
             }
         }
     };
+
+    CompileLabels();
+    BuildDecodeTable();
+  }
+
+  Chip8::~Chip8() = default;
+
+  /* Every handler in Op order, XQ marks the ones templated on the quirk set */
+#define DORITO_CHIP8_OPS(X, XQ) \
+  X(Unimplemented) X(ClearScreen) X(Return) X(Jump) X(Call) X(SkipEqualsLiteral) \
+  X(SkipNotEqualsLiteral) X(SkipRegEqualsReg) X(LoadLiteral) X(AddLiteral) X(LoadRegister) \
+  XQ(ORReg) XQ(ANDReg) XQ(XORReg) X(Add) X(SubtractYFromX) XQ(ShiftRight) X(SubtractXFromY) \
+  XQ(ShiftLeft) X(SkipRegNotEqualReg) X(LoadILiteral) X(LoadIExtended) XQ(JumpRelative) \
+  X(Random) XQ(DrawSprite) X(SkipKeyPressed) X(SkipKeyNotPressed) X(LoadDelayToReg) \
+  X(LoadKeypressToReg) X(LoadRegToDelay) X(LoadRegToBuzzer) XQ(AddIWithReg) \
+  X(LoadISpriteAddr) X(LoadBCD) XQ(RegisterSaveIncrement) XQ(RegisterLoadIncrement) \
+  X(SaveFlags) X(LoadFlags) X(Exit) X(LoadIBigSpriteAddr) X(Hires) X(Lores) X(ScrollDown) \
+  X(ScrollRight) X(ScrollLeft) X(ScrollUp) X(Plane) X(RegisterSave) X(RegisterLoad) \
+  X(Pitch) X(Audio)
+
+  const char *Chip8::OpName(Op op) {
+#define DORITO_OP_NAME(name) #name,
+    static const char *names[] = {
+        DORITO_CHIP8_OPS(DORITO_OP_NAME, DORITO_OP_NAME)
+    };
+#undef DORITO_OP_NAME
+
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Op::Count));
+
+    return op < Op::Count ? names[static_cast<uint8_t>(op)] : "?";
+  }
+
+  void Chip8::SyncQuirks() {
+    uint8_t mask = 0;
+
+    for (uint8_t n = 0; n < 8; n++) {
+      if (regs.quirks[n])
+        mask |= 1 << n;
+    }
+
+    switch (mask) {
+      case VIPQuirks:
+        UseQuirks<VIPQuirks>();
+        break;
+
+      case SCHIPQuirks:
+        UseQuirks<SCHIPQuirks>();
+        break;
+
+      case XOChipQuirks:
+        UseQuirks<XOChipQuirks>();
+        break;
+
+      default:
+        UseQuirks<CustomQuirks>();
+        break;
+    }
+
+#if defined(DORITO_JIT)
+    // Generated code has the quirks baked in
+    if (m_Recompiler && !m_Recompiler->QuirksMatch(regs.quirks))
+      FlushNative();
+#endif
+  }
+
+  template<uint16_t Q>
+  void Chip8::UseQuirks() {
+    m_QuirkSet = Q;
+    m_Procs = ProcTable<Q>();
+    m_ExecuteBlock = &Chip8::Execute<Q>;
+  }
+
+  template<uint16_t Q>
+  const Chip8::InstructionProc *Chip8::ProcTable() {
+#define DORITO_PROC(name) &Chip8::Proc##name,
+#define DORITO_QUIRKED_PROC(name) &Chip8::Proc##name<Q>,
+    static const InstructionProc procs[] = {
+        DORITO_CHIP8_OPS(DORITO_PROC, DORITO_QUIRKED_PROC)
+    };
+#undef DORITO_QUIRKED_PROC
+#undef DORITO_PROC
+
+    static_assert(sizeof(procs) / sizeof(procs[0]) == static_cast<size_t>(Op::Count));
+
+    return procs;
   }
 
   void Chip8::Reset() {
@@ -443,11 +529,18 @@ namespace dorito {
     memset(regs.v, 0, 16);
     memset(regs.keys, false, 16);
     memset(regs.quirks, false, 8);
+    SyncQuirks();
     memset(mOperands, 0, sizeof(mOperands));
 
     m_Cycles = 0;
     m_Halted = true;
+    m_BreakpointHit = false;
+    m_ResumeFrom = -1;
     m_Waiting = false;
+
+    m_Tracer.Clear();
+    m_Profiler.Clear();
+    m_Profiler.EndFrame(0);
     m_HighRes = false;
     m_KeyPressRegister = 0;
     m_PitchDirty = false;
@@ -456,26 +549,64 @@ namespace dorito {
 
     m_WaitForInterrupt = 0;
 
-    m_Disassembly.clear();
-    m_DisasmCount = 0;
+    ClearDisassembly();
+
+    FlushDecoded();
   }
 
   void Chip8::Tick(uint32_t cycles) {
     if (m_Halted || m_Waiting)
       return;
 
-    m_Cycles += cycles;
+    if (m_Threaded && !MustStep()) {
+      RunThreaded(cycles);
+    } else {
+      /* Once we're halted, waiting on a key or spinning on a draw
+       * until the next interrupt nothing else can happen this frame.
+       */
+      for (uint32_t c = 0; c < cycles; c++) {
+        if (m_Halted || m_Waiting || m_WaitForInterrupt == 1)
+          break;
+
+        Step();
+      }
+    }
+
+    if (m_WaitForInterrupt == 1) {
+      m_WaitForInterrupt = 2;
+    }
+  }
 
+  bool Chip8::TickUntil(uint16_t addr, uint32_t cycles) {
+    if (m_Halted || m_Waiting)
+      return false;
+
+    bool reached = false;
+
+    // Always step at least once so running to the current pc finds its next visit
     for (uint32_t c = 0; c < cycles; c++) {
+      if (m_Halted || m_Waiting || m_WaitForInterrupt == 1)
+        break;
+
       Step();
+
+      if (regs.pc == addr && !m_Halted) {
+        reached = true;
+        break;
+      }
     }
 
     if (m_WaitForInterrupt == 1) {
       m_WaitForInterrupt = 2;
     }
+
+    return reached;
   }
 
   void Chip8::TickTimers() {
+    if (m_Profiler.Enabled())
+      m_Profiler.EndFrame(m_Cycles);
+
     if (regs.st > 0)
       regs.st--;
 
@@ -489,43 +620,150 @@ namespace dorito {
 
     m_PrevPC = regs.pc;
 
-    DisassembleNext();
-    Fetch();
-
-    auto it = std::find_if(regs.breakpoints.begin(),
-                           regs.breakpoints.end(),
-                           [&](const Breakpoint &breakpoint) {
-                             return breakpoint.enabled && (breakpoint.addr == regs.pc);
-                           });
-
-    if (it != std::end(regs.breakpoints)) {
-      EventManager::Dispatcher().trigger<Events::ExecuteCPU>(Events::ExecuteCPU{false});
+    // Stop before the instruction at the breakpoint runs
+    if (m_Breakpoints.Armed(regs.pc) && BreakpointStops()) {
+      m_Halted = true;
+      m_BreakpointHit = true;
       return;
     }
 
+    m_ResumeFrom = -1;
+
+    Discover(regs.pc);
+    Fetch();
+
+    m_Cycles++;
+
     // Execute
-    if (m_CurrentInstruction) {
+    if (m_Tracer.Enabled()) [[unlikely]] {
+      auto &entry = m_Tracer.Begin(m_Cycles, m_PrevPC, regs.latch, regs.v);
+
+      if (m_CurrentInstruction)
+        (this->*m_Procs[static_cast<uint8_t>(m_CurrentInstruction->op)])();
+
+      Tracer::End(entry, regs.i, regs.v);
+    } else if (m_CurrentInstruction) {
       // Lol this syntax is toxic
-      (this->*(m_CurrentInstruction->proc))();
+      (this->*m_Procs[static_cast<uint8_t>(m_CurrentInstruction->op)])();
+    }
+
+    if (m_Profiler.Enabled() && m_CurrentInstruction)
+      m_Profiler.Count(m_PrevPC, static_cast<uint8_t>(m_CurrentInstruction->op));
+
+    // Watchpoints stop after the instruction that touched the data
+    auto &watchpoints = m_Ram->GetWatchpoints();
+
+    if (watchpoints.Triggered()) {
+      watchpoints.ClearTriggered();
+      m_Halted = true;
+      m_BreakpointHit = true;
+      m_Machine.Warn(watchpoints.LastHit());
     }
   }
 
-  void Chip8::Fetch() {
-    auto &bus = Bus::Get();
+  Chip8::State Chip8::GetState() const {
+    State state{};
 
-    uint8_t high = bus.Read(regs.pc++);
-    uint8_t low = bus.Read(regs.pc++);
+    state.regs = regs;
+    state.cycles = m_Cycles;
+    state.randomDraws = m_RandomDraws;
+    state.waiting = m_Waiting;
+    state.highRes = m_HighRes;
+    state.pitchDirty = m_PitchDirty;
+    state.keyPressRegister = m_KeyPressRegister;
+    state.waitForInterrupt = m_WaitForInterrupt;
 
-    regs.latch = (high << 8) | low;
+    return state;
+  }
+
+  void Chip8::SetState(const State &state) {
+    regs = state.regs;
+    m_Cycles = state.cycles;
+    m_RandomDraws = state.randomDraws;
+    m_Waiting = state.waiting;
+    m_HighRes = state.highRes;
+    m_PitchDirty = state.pitchDirty;
+    m_KeyPressRegister = state.keyPressRegister;
+    m_WaitForInterrupt = state.waitForInterrupt;
 
-    m_CurrentInstruction = Decode(regs.latch);
+    m_CurrentInstruction = nullptr;
+    m_ResumeFrom = -1;
 
-    ExtractOperands(regs.latch, m_CurrentInstruction, true);
+    SyncQuirks();
   }
 
-  void Chip8::ExtractOperands(uint16_t opcode, Chip8::Instruction *current, bool advancePC) {
-    auto &bus = Bus::Get();
+  void Chip8::Replay(uint64_t count) {
+    for (uint64_t c = 0; c < count; c++) {
+      if (m_Waiting || m_WaitForInterrupt == 1)
+        break;
+
+      m_PrevPC = regs.pc;
+
+      Fetch();
+      m_Cycles++;
+
+      if (m_CurrentInstruction)
+        (this->*m_Procs[static_cast<uint8_t>(m_CurrentInstruction->op)])();
+    }
 
+    m_Ram->GetWatchpoints().ClearTriggered();
+  }
+
+  bool Chip8::BreakpointStops() {
+    if (regs.pc == m_ResumeFrom)
+      return false;
+
+    BreakpointCondition::State state{};
+
+    std::copy_n(regs.v, 16, state.begin());
+    state[BreakpointCondition::I] = regs.i;
+    state[BreakpointCondition::PC] = regs.pc;
+    state[BreakpointCondition::DT] = regs.dt;
+    state[BreakpointCondition::ST] = regs.st;
+
+    if (!m_Breakpoints.Hit(regs.pc, state))
+      return false;
+
+    m_ResumeFrom = regs.pc;
+
+    return true;
+  }
+
+  void Chip8::Fetch() {
+    auto &decoded = DecodeAt(regs.pc);
+
+    regs.latch = decoded.latch;
+    regs.pc += decoded.length;
+
+    m_CurrentInstruction = decoded.instruction;
+    std::copy_n(decoded.operands, 3, mOperands);
+  }
+
+  Chip8::DecodedInstruction &Chip8::DecodeAt(uint16_t addr) {
+    auto &decoded = m_DecodeCache[addr];
+
+    if (decoded.valid)
+      return decoded;
+
+    uint8_t high = Read(addr);
+    uint8_t low = Read(addr + 1);
+
+    decoded.latch = (high << 8) | low;
+    decoded.instruction = Decode(decoded.latch, true);
+    decoded.length = decoded.instruction->code == 0xF000 ? 4 : 2;
+
+    if (decoded.instruction == m_InvalidInstruction)
+      m_Machine.Warn(fmt::format("Invalid opcode at 0x{:04X}: 0x{:04X}", addr, decoded.latch));
+
+    memset(decoded.operands, 0, sizeof(decoded.operands));
+    ExtractOperands(addr, decoded.latch, decoded.instruction, decoded.operands);
+
+    decoded.valid = true;
+
+    return decoded;
+  }
+
+  void Chip8::ExtractOperands(uint16_t addr, uint16_t opcode, Chip8::Instruction *current, Operand *operands) {
     uint16_t operand = opcode & 0x0FFF;
 
     auto currentNibble = [](uint16_t operand, uint8_t position) {
@@ -540,26 +778,26 @@ namespace dorito {
 
       if (current->code == 0x00C0 ||
           current->code == 0x00D0) {
-        mOperands[0].type = OperandType::Number4bit;
-        mOperands[0].value = opcode & 0x000F;
+        operands[0].type = OperandType::Number4bit;
+        operands[0].value = opcode & 0x000F;
         break;
       }
 
       if (current->code == 0xF001) {
-        mOperands[0].type = OperandType::Number4bit;
-        mOperands[0].value = (opcode & 0x0F00) >> 8;
+        operands[0].type = OperandType::Number4bit;
+        operands[0].value = (opcode & 0x0F00) >> 8;
         break;
       }
 
       auto type = current->operand_order[i];
       auto currentNibblePosition = 2 - i;
 
-      mOperands[i].type = type;
+      operands[i].type = type;
 
       switch (type) {
         case OperandType::Register:
         case OperandType::Number4bit:
-          mOperands[i].value = currentNibble(operand, currentNibblePosition);
+          operands[i].value = currentNibble(operand, currentNibblePosition);
           break;
 
         case OperandType::Number8bit: {
@@ -567,28 +805,354 @@ namespace dorito {
           currentNibblePosition--;
           auto lowNibble = currentNibble(operand, currentNibblePosition);
 
-          mOperands[i].value = (highNibble << 4) | lowNibble;
+          operands[i].value = (highNibble << 4) | lowNibble;
         }
           break;
 
         case OperandType::Number12bit:
-          mOperands[i].value = operand;
+          operands[i].value = operand;
           break;
 
         case OperandType::Number16bit: {
-          uint8_t addrHigh = advancePC ? bus.Read(regs.pc++) : bus.Read(regs.pc + 2);
-          uint8_t addrLow = advancePC ? bus.Read(regs.pc++) : bus.Read(regs.pc + 3);
+          uint8_t addrHigh = Read(addr + 2);
+          uint8_t addrLow = Read(addr + 3);
+
+          operands[i].value = (addrHigh << 8) | addrLow;
+        }
+          break;
+      }
+    }
+  }
 
-          uint16_t addr = (addrHigh << 8) | addrLow;
+  void Chip8::RunThreaded(uint32_t cycles) {
+    Block *block = &LookupBlock(regs.pc);
 
-          mOperands[i].value = addr;
+    while (cycles > 0) {
+      if (block->ops.size() > cycles) {
+        // Not enough budget left for the whole block, finish the frame a step at a time
+        while (cycles-- > 0 && !m_Halted && !m_Waiting && m_WaitForInterrupt != 1) {
+          Step();
         }
+
+        return;
+      }
+
+      auto retired = RunBlock(*block);
+
+      if (m_Profiler.Enabled()) [[unlikely]] {
+        for (uint32_t n = 0; n < retired; n++) {
+          m_Profiler.Count(block->ops[n].addr, static_cast<uint8_t>(block->ops[n].op));
+        }
+      }
+
+      cycles -= retired;
+      m_Cycles += retired;
+
+      if (m_Halted || m_Waiting || m_WaitForInterrupt == 1)
+        return;
+
+      Block *next = nullptr;
+
+      for (auto link: block->links) {
+        if (link && link->valid && link->start == regs.pc) {
+          next = link;
+          break;
+        }
+      }
+
+      if (!next) {
+        next = &LookupBlock(regs.pc);
+        block->links[block->nextLink++ & 1] = next;
+      }
+
+      block = next;
+    }
+  }
+
+  Chip8::Block &Chip8::LookupBlock(uint16_t addr) {
+    auto &block = m_Blocks[addr];
+
+    if (!block)
+      block = CreateScope<Block>();
+
+    if (!block->valid)
+      TranslateBlock(addr, *block);
+
+    return *block;
+  }
+
+  void Chip8::TranslateBlock(uint16_t addr, Block &block) {
+    uint32_t pc = addr;
+
+    block.start = addr;
+    block.ops.clear();
+
+    Discover(addr);
+
+    while (pc <= 0xFFFF && block.ops.size() < m_MaxBlockLength) {
+      auto &decoded = DecodeAt(pc);
+      auto op = decoded.instruction->op;
+
+      BlockOp blockOp{
+          op,
+          static_cast<uint16_t>(pc),
+          static_cast<uint16_t>(pc + decoded.length),
+          decoded.latch,
+          decoded.instruction,
+          {}
+      };
+
+      std::copy_n(decoded.operands, 3, blockOp.operands);
+      block.ops.push_back(blockOp);
+
+      pc += decoded.length;
+
+      bool leavesBlock = false;
+
+      switch (op) {
+        case Op::Return:
+        case Op::Jump:
+        case Op::Call:
+        case Op::JumpRelative:
+        case Op::SkipEqualsLiteral:
+        case Op::SkipNotEqualsLiteral:
+        case Op::SkipRegEqualsReg:
+        case Op::SkipRegNotEqualReg:
+        case Op::SkipKeyPressed:
+        case Op::SkipKeyNotPressed:
+        case Op::DrawSprite:
+        case Op::LoadKeypressToReg:
+        case Op::Exit:
+          leavesBlock = true;
+          break;
+
+        default:
           break;
       }
+
+      if (leavesBlock)
+        break;
+    }
+
+    block.end = pc;
+
+    for (uint32_t page = block.start >> 8; page <= ((block.end - 1) >> 8) && page < 0x100; page++) {
+      m_CodePages[page] = true;
+    }
+
+    block.links[0] = nullptr;
+    block.links[1] = nullptr;
+    block.nextLink = 0;
+    block.native = nullptr;
+    block.heat = 0;
+    block.nativeRejected = false;
+    block.valid = true;
+  }
+
+  uint32_t Chip8::RunBlock(Block &block) {
+#if defined(DORITO_JIT)
+    if (m_Recompiler && !block.native && !block.nativeRejected && ++block.heat >= m_JitThreshold) {
+      if (!m_Recompiler->Compile(*this, block)) {
+        // Out of code space, start over
+        FlushNative();
+        m_Recompiler->Compile(*this, block);
+      }
     }
+
+    if (block.native) {
+      if (m_JitChecked)
+        return m_Recompiler->ExecuteChecked(*this, block);
+
+      uint32_t retired = block.native(this, &regs);
+
+      // Leave the debugger state as the interpreter would, the pc is already up to date
+      auto pc = regs.pc;
+      Enter(block.ops[retired - 1]);
+      regs.pc = pc;
+
+      return retired;
+    }
+#endif
+
+    return ExecuteBlock(block);
+  }
+
+  /* The threaded interpreter, one instance per quirk set. Each handler
+   * gets its own dispatch site so the host can predict op to op transitions.
+   */
+  template<uint16_t Q>
+  uint32_t Chip8::Execute(Block &block) {
+    const BlockOp *op = block.ops.data();
+    const BlockOp *end = op + block.ops.size();
+
+#if defined(__GNUC__)
+#define DORITO_OP_LABEL(name) &&Op##name,
+    static const void *dispatch[] = {
+        DORITO_CHIP8_OPS(DORITO_OP_LABEL, DORITO_OP_LABEL)
+    };
+#undef DORITO_OP_LABEL
+
+    static_assert(sizeof(dispatch) / sizeof(dispatch[0]) == static_cast<size_t>(Op::Count));
+
+    Enter(*op);
+    goto *dispatch[static_cast<uint8_t>(op->op)];
+
+#define DORITO_OP_HANDLER(name, proc) \
+    Op##name: \
+      proc(); \
+      if (++op == end || !block.valid) \
+        goto done; \
+      Enter(*op); \
+      goto *dispatch[static_cast<uint8_t>(op->op)];
+#define DORITO_PLAIN_OP_HANDLER(name) DORITO_OP_HANDLER(name, Proc##name)
+#define DORITO_QUIRKED_OP_HANDLER(name) DORITO_OP_HANDLER(name, Proc##name<Q>)
+
+    DORITO_CHIP8_OPS(DORITO_PLAIN_OP_HANDLER, DORITO_QUIRKED_OP_HANDLER)
+#undef DORITO_QUIRKED_OP_HANDLER
+#undef DORITO_PLAIN_OP_HANDLER
+#undef DORITO_OP_HANDLER
+
+    done:
+#else
+#define DORITO_OP_CASE(name) \
+      case Op::name: \
+        Proc##name(); \
+        break;
+#define DORITO_QUIRKED_OP_CASE(name) \
+      case Op::name: \
+        Proc##name<Q>(); \
+        break;
+
+    while (op != end) {
+      Enter(*op);
+
+      switch (op->op) {
+        DORITO_CHIP8_OPS(DORITO_OP_CASE, DORITO_QUIRKED_OP_CASE)
+
+        default:
+          break;
+      }
+
+      op++;
+
+      if (!block.valid)
+        break;
+    }
+#undef DORITO_QUIRKED_OP_CASE
+#undef DORITO_OP_CASE
+#endif
+
+    return static_cast<uint32_t>(op - block.ops.data());
+  }
+
+#undef DORITO_CHIP8_OPS
+
+  void Chip8::InvalidateBlocks(uint16_t addr) {
+    uint32_t first = addr >= m_MaxBlockLength * 4 ? addr - m_MaxBlockLength * 4 : 0;
+
+    for (uint32_t start = first; start <= addr; start++) {
+      auto &block = m_Blocks[start];
+
+      if (block && block->valid && addr < block->end)
+        block->valid = false;
+    }
+  }
+
+  void Chip8::InvalidateRange(uint16_t from, uint32_t to) {
+    if (to <= from)
+      return;
+
+    for (uint32_t addr = from >= 3 ? from - 3 : 0; addr < to; addr++) {
+      m_DecodeCache[addr].valid = false;
+    }
+
+    bool code = false;
+    for (uint32_t page = from >> 8; page <= (to - 1) >> 8; page++) {
+      code |= m_CodePages[page];
+    }
+
+    if (code) {
+      uint32_t first = from >= m_MaxBlockLength * 4 ? from - m_MaxBlockLength * 4 : 0;
+
+      for (uint32_t start = first; start < to; start++) {
+        auto &block = m_Blocks[start];
+
+        if (block && block->valid && from < block->end)
+          block->valid = false;
+      }
+    }
+
+    if (m_DisassemblyEnabled) {
+      for (uint32_t addr = from; addr < to; addr++) {
+        if (m_Analyzed[addr] && !m_DisassemblyStale[addr]) {
+          m_DisassemblyStale[addr] = true;
+          m_StaleCode.push_back(static_cast<uint16_t>(addr));
+        }
+      }
+    }
+  }
+
+  void Chip8::FlushDecoded() {
+    for (auto &decoded: m_DecodeCache) {
+      decoded.valid = false;
+    }
+
+    for (auto &block: m_Blocks) {
+      if (block)
+        block->valid = false;
+    }
+
+    m_CodePages.assign(m_CodePages.size(), false);
+  }
+
+  void Chip8::FlushNative() {
+    for (auto &block: m_Blocks) {
+      if (block) {
+        block->native = nullptr;
+        block->heat = 0;
+      }
+    }
+
+#if defined(DORITO_JIT)
+    if (m_Recompiler)
+      m_Recompiler->Reset();
+#endif
+  }
+
+  void Chip8::Jit(bool isSet) {
+    m_Jit = isSet && JitAvailable();
+
+#if defined(DORITO_JIT)
+    if (m_Jit && !m_Recompiler) {
+      m_Recompiler = CreateScope<Recompiler>();
+    } else if (!m_Jit && m_Recompiler) {
+      FlushNative();
+      m_Recompiler.reset();
+    }
+#endif
   }
 
   Chip8::Instruction *Chip8::Decode(uint16_t code, bool silent) {
+    auto instruction = m_DecodeTable[code];
+
+    if (instruction == m_InvalidInstruction && !silent)
+      m_Machine.Warn(fmt::format("Invalid opcode at 0x{:04X}: 0x{:04X}", regs.pc - 2, code));
+
+    return instruction;
+  }
+
+  void Chip8::BuildDecodeTable() {
+    m_InvalidInstruction = &m_Instructions[0xFFFF];
+
+    for (uint32_t code = 0; code <= 0xFFFF; code++) {
+      m_DecodeTable[code] = DecodeInstruction(code);
+    }
+  }
+
+  /* Only used to build the decode table, everything at runtime goes
+   * through Decode.
+   */
+  Chip8::Instruction *Chip8::DecodeInstruction(uint16_t code) {
     /* I never thought an ISA would make me miss
      * addressing modes. Yet here we are.
      */
@@ -611,9 +1175,7 @@ namespace dorito {
                 return &m_Instructions[code & 0xF0];
             }
 
-            if (!silent)
-              spdlog::get("console")->warn("Invalid opcode at 0x{:04X}: 0x{:04X}", regs.pc - 2, code);
-            return &m_Instructions[0xFFFF];
+            return m_InvalidInstruction;
         }
 
       case 0x1:
@@ -647,9 +1209,7 @@ namespace dorito {
             return &m_Instructions[code & 0xF00F];
 
           default:
-            if (!silent)
-              spdlog::get("console")->warn("Invalid opcode at 0x{:04X}: 0x{:04X}", regs.pc - 2, regs.latch);
-            return &m_Instructions[0xFFFF];
+            return m_InvalidInstruction;
         }
 
       case 0xE:
@@ -659,9 +1219,7 @@ namespace dorito {
             return &m_Instructions[code & 0xF0FF];
 
           default:
-            if (!silent)
-              spdlog::get("console")->warn("Invalid opcode at 0x{:04X}: 0x{:04X}", regs.pc - 2, regs.latch);
-            return &m_Instructions[0xFFFF];
+            return m_InvalidInstruction;
         }
 
       case 0xF:
@@ -685,49 +1243,65 @@ namespace dorito {
             return &m_Instructions[code & 0xF0FF];
 
           default:
-            if (!silent)
-              spdlog::get("console")->warn("Invalid opcode at 0x{:04X}: 0x{:04X}", regs.pc - 2, regs.latch);
-            return &m_Instructions[0xFFFF];
+            return m_InvalidInstruction;
         }
     }
 
     // Shouldn't get here, just for completeness.
-    if (!silent)
-      spdlog::get("console")->warn("Invalid opcode at 0x{:04X}: 0x{:04X}", regs.pc - 2, regs.latch);
-    return &m_Instructions[0xFFFF];
+    return m_InvalidInstruction;
   }
 
-  void Chip8::DisassembleNext() {
-    auto &bus = Bus::Get();
+  /* Only ever called by DisassembleFrom on an address no line covers
+   * yet, the line is appended for IndexDisassembly to sort in.
+   */
+  void Chip8::Disassemble(uint16_t addr) {
+    auto &decoded = DecodeAt(addr);
+    auto current = decoded.instruction;
+    auto operands = decoded.operands;
 
-    uint8_t high = bus.Read(regs.pc);
-    uint8_t low = bus.Read(regs.pc + 1);
-    uint8_t nextHigh = bus.Read(regs.pc + 2);
-    uint8_t nextLow = bus.Read(regs.pc + 3);
+    auto &out = m_DisassemblyText;
 
-    uint16_t opcode = (high << 8) | low;
+    out.clear();
+    for (const auto &part: current->parts) {
+      out.append(part.text);
 
-    auto current = Decode(opcode, true);
-    ExtractOperands(opcode, current, false);
+      if (part.operand >= 0)
+        FormatOperand(out, operands[part.operand]);
+    }
+
+    std::string text = fmt::to_string(out);
+
+    out.clear();
+    fmt::format_to(std::back_inserter(out), FMT_COMPILE("{:02X} {:02X}"), decoded.latch >> 8, decoded.latch & 0xFF);
 
-    bool isExtended = current->code == 0xF000;
+    if (current->code == 0xF000)
+      fmt::format_to(std::back_inserter(out), FMT_COMPILE(" {:02X} {:02X}"), operands[0].value >> 8, operands[0].value & 0xFF);
+
+    m_Disassembly.push_back({
+        addr,
+        decoded.length,
+        std::move(text),
+        fmt::to_string(out)
+    });
+  }
+
+  /* Each operand takes the first placeholder for its type still left in
+   * the label, X then Y for registers, N, NN, NNN or NNNN for numbers.
+   */
+  void Chip8::CompileLabels() {
+    for (auto &[_, instruction]: m_Instructions) {
+      std::string label = instruction.label;
+      std::vector<std::pair<size_t, std::pair<size_t, int8_t>>> slots;
 
-    if (!m_Disassembly.contains(regs.pc)) {
       bool firstReg = true;
-      std::string code = current->label;
 
-      // Populate Operands
-      for (uint8_t i = 0; i < current->operand_count; i++) {
-        std::string pattern;
+      for (uint8_t i = 0; i < instruction.operand_count; i++) {
+        std::string_view pattern;
 
-        switch (mOperands[i].type) {
+        switch (instruction.operand_order[i]) {
           case OperandType::Register:
-            if (firstReg) {
-              pattern = "X";
-              firstReg = false;
-            } else {
-              pattern = "Y";
-            }
+            pattern = firstReg ? "X" : "Y";
+            firstReg = false;
             break;
           case OperandType::Number4bit:
             pattern = "N";
@@ -743,53 +1317,222 @@ namespace dorito {
             break;
         }
 
-        std::regex re{pattern};
-        std::smatch m;
+        auto pos = label.find(pattern);
+        if (pos == std::string::npos)
+          continue;
+
+        // Blank it out so the next operand can't match the same placeholder
+        label.replace(pos, pattern.size(), pattern.size(), '\0');
+        slots.push_back({pos, {pattern.size(), static_cast<int8_t>(i)}});
+      }
+
+      std::sort(slots.begin(), slots.end());
 
-        if (std::regex_search(code, m, re)) {
-          std::string formatted;
+      instruction.parts.clear();
 
-          switch (mOperands[i].type) {
-            case OperandType::Register:
-            case OperandType::Number4bit:
-              formatted = fmt::format("{:1X}", mOperands[i].value);
-              break;
+      size_t from = 0;
+      for (const auto &[pos, slot]: slots) {
+        instruction.parts.push_back({instruction.label.substr(from, pos - from), slot.second});
+        from = pos + slot.first;
+      }
 
-            case OperandType::Number8bit:
-              formatted = fmt::format("0x{:02X} ({})", mOperands[i].value, mOperands[i].value);
-              break;
+      instruction.parts.push_back({instruction.label.substr(from), -1});
+    }
+  }
 
-            case OperandType::Number12bit:
-              formatted = fmt::format("0x{:03X} ({})", mOperands[i].value, mOperands[i].value);
-              break;
+  void Chip8::FormatOperand(fmt::memory_buffer &out, const Operand &operand) {
+    auto it = std::back_inserter(out);
 
-            case OperandType::Number16bit:
-              formatted = fmt::format("0x{:4X} ({})", mOperands[i].value, mOperands[i].value);
-              break;
-          }
+    switch (operand.type) {
+      case OperandType::Register:
+      case OperandType::Number4bit:
+        fmt::format_to(it, FMT_COMPILE("{:1X}"), operand.value);
+        break;
+
+      case OperandType::Number8bit:
+        fmt::format_to(it, FMT_COMPILE("0x{:02X} ({})"), operand.value, operand.value);
+        break;
+
+      case OperandType::Number12bit:
+        fmt::format_to(it, FMT_COMPILE("0x{:03X} ({})"), operand.value, operand.value);
+        break;
+
+      case OperandType::Number16bit:
+        fmt::format_to(it, FMT_COMPILE("0x{:4X} ({})"), operand.value, operand.value);
+        break;
+    }
+  }
+
+  void Chip8::DisassembleFrom(uint16_t addr) {
+    std::vector<uint16_t> pending{addr};
+
+    while (!pending.empty()) {
+      uint16_t pc = pending.back();
+      pending.pop_back();
+
+      if (m_Analyzed[pc])
+        continue;
+
+      // Whatever doesn't decode is taken for data, unless it was actually run
+      uint16_t code = (Read(pc) << 8) | Read(pc + 1);
+      if (m_DecodeTable[code] == m_InvalidInstruction && pc != addr)
+        continue;
+
+      Disassemble(pc);
+
+      auto &decoded = DecodeAt(pc);
+      uint16_t next = pc + decoded.length;
+
+      for (uint8_t n = 0; n < decoded.length; n++) {
+        m_Analyzed[static_cast<uint16_t>(pc + n)] = true;
+      }
+
+      switch (decoded.instruction->op) {
+        case Op::Jump:
+          pending.push_back(decoded.operands[0].value);
+          break;
 
-          code.replace(m[0].first, m[0].second, formatted);
+        case Op::Call:
+          pending.push_back(next);
+          pending.push_back(decoded.operands[0].value);
+          break;
+
+        // Nowhere to go, or only known once it runs
+        case Op::Return:
+        case Op::Exit:
+        case Op::JumpRelative:
+          break;
+
+        case Op::SkipEqualsLiteral:
+        case Op::SkipNotEqualsLiteral:
+        case Op::SkipRegEqualsReg:
+        case Op::SkipRegNotEqualReg:
+        case Op::SkipKeyPressed:
+        case Op::SkipKeyNotPressed: {
+          uint16_t skipped = (Read(next) << 8) | Read(next + 1);
+
+          pending.push_back(next);
+          pending.push_back(next + (skipped == 0xF000 ? 4 : 2));
+          break;
         }
+
+        default:
+          if (decoded.instruction != m_InvalidInstruction)
+            pending.push_back(next);
+          break;
       }
+    }
+  }
 
-      std::string bytes = isExtended
-                          ? fmt::format("{:02X} {:02X} {:02X} {:02X}",
-                                        high, low, nextHigh, nextLow)
-                          : fmt::format("{:02X} {:02X}", high, low);
+  void Chip8::IndexDisassembly() {
+    for (size_t row = m_IndexedLines; row < m_Disassembly.size(); row++) {
+      m_DisassemblyRows[m_Disassembly[row].addr] = static_cast<int32_t>(row);
+    }
 
-      m_Disassembly[regs.pc] = {
-          static_cast<uint16_t>(regs.pc),
-          m_DisasmCount++,
-          code,
-          bytes
-      };
+    /* No two lines start at the same address, so one pass over the
+     * address space puts them in order. Lines whose row was cleared
+     * by UpdateDisassembly are dropped on the way.
+     */
+    std::vector<DisassemblyLine> sorted;
+    sorted.reserve(m_Disassembly.size());
+
+    for (auto &row: m_DisassemblyRows) {
+      if (row < 0)
+        continue;
+
+      sorted.push_back(std::move(m_Disassembly[row]));
+      row = static_cast<int32_t>(sorted.size() - 1);
+    }
+
+    m_Disassembly = std::move(sorted);
+    m_IndexedLines = m_Disassembly.size();
+  }
+
+  int32_t Chip8::DisassemblyRow(uint16_t addr) const {
+    if (m_DisassemblyRows[addr] >= 0)
+      return m_DisassemblyRows[addr];
+
+    auto end = m_Disassembly.begin() + static_cast<ptrdiff_t>(m_IndexedLines);
+    auto after = std::upper_bound(m_Disassembly.begin(), end, addr,
+                                  [](uint16_t addr, const DisassemblyLine &line) {
+                                    return addr < line.addr;
+                                  });
+
+    return static_cast<int32_t>(after - m_Disassembly.begin()) - 1;
+  }
+
+  void Chip8::ClearDisassembly() {
+    m_Disassembly.clear();
+    m_IndexedLines = 0;
+    m_DisassemblyRows.assign(m_DisassemblyRows.size(), -1);
+    m_Analyzed.assign(m_Analyzed.size(), false);
+    m_DisassemblyStale.assign(m_DisassemblyStale.size(), false);
+    m_StaleCode.clear();
+  }
+
+  void Chip8::DisassemblyEnabled(bool isEnabled) {
+    if (isEnabled == m_DisassemblyEnabled)
+      return;
+
+    m_DisassemblyEnabled = isEnabled;
+
+    if (m_DisassemblyEnabled) {
+      // Translated blocks never look at the disassembly again, have them rebuilt
+      FlushDecoded();
+      Analyze();
+    } else {
+      ClearDisassembly();
+    }
+  }
+
+  void Chip8::Analyze() {
+    ClearDisassembly();
+
+    if (!m_DisassemblyEnabled)
+      return;
+
+    DisassembleFrom(0x200);
+    DisassembleFrom(regs.pc);
+    IndexDisassembly();
+  }
+
+  void Chip8::UpdateDisassembly() {
+    // Lines found by Discover have no row yet, give them one before looking up what was written over
+    if (m_IndexedLines < m_Disassembly.size())
+      IndexDisassembly();
+
+    if (m_StaleCode.empty())
+      return;
+
+    std::vector<uint16_t> roots;
 
-      uint8_t index = 0;
-      for (auto &[_, line]: m_Disassembly) {
-        line.index = index++;
+    for (auto addr: m_StaleCode) {
+      m_DisassemblyStale[addr] = false;
+
+      // Drop every line covering the written byte, an F000 one may start 3 bytes back
+      for (uint8_t n = 0; n < 4; n++) {
+        uint16_t start = addr - n;
+        auto row = m_DisassemblyRows[start];
+
+        if (row < 0 || static_cast<uint16_t>(addr - start) >= m_Disassembly[row].length)
+          continue;
+
+        for (uint8_t b = 0; b < m_Disassembly[row].length; b++) {
+          m_Analyzed[static_cast<uint16_t>(start + b)] = false;
+        }
+
+        m_DisassemblyRows[start] = -1;
+        roots.push_back(start);
       }
+    }
 
+    m_StaleCode.clear();
+
+    for (auto root: roots) {
+      DisassembleFrom(root);
     }
+
+    IndexDisassembly();
   }
 
   void Chip8::SetFlag(uint8_t dest, uint16_t value, bool isSet) {
@@ -798,12 +1541,7 @@ namespace dorito {
   }
 
   void Chip8::Skip() {
-    auto &bus = Bus::Get();
-
-    uint8_t high = bus.Read(regs.pc);
-    uint8_t low = bus.Read(regs.pc + 1);
-
-    uint16_t nextOp = (high << 8) | low;
+    uint16_t nextOp = DecodeAt(regs.pc).latch;
 
     regs.pc += (nextOp == 0xF000) ? 4 : 2;
   }
@@ -815,41 +1553,31 @@ namespace dorito {
 
   /* 00CN */
   void Chip8::ProcScrollDown() {
-    auto &bus = Bus::Get();
-
-    bus.ScrollDown(mOperands[0].value);
+    m_Display->ScrollDown(mOperands[0].value);
   }
 
   void Chip8::ProcScrollUp() {
-    auto &bus = Bus::Get();
-
-    bus.ScrollUp(mOperands[0].value);
+    m_Display->ScrollUp(mOperands[0].value);
   }
 
   /* 00E0 */
   void Chip8::ProcClearScreen() {
-    auto &bus = Bus::Get();
-    bus.ClearScreen();
+    m_Display->Clear();
   }
 
   /* 00EE */
   void Chip8::ProcReturn() {
-    auto &bus = Bus::Get();
-    regs.pc = bus.Pop();
+    regs.pc = m_Ram->Pop();
   }
 
   /* 00FB */
   void Chip8::ProcScrollRight() {
-    auto &bus = Bus::Get();
-
-    bus.ScrollRight();
+    m_Display->ScrollRight(4);
   }
 
   /* 00FC */
   void Chip8::ProcScrollLeft() {
-    auto &bus = Bus::Get();
-
-    bus.ScrollLeft();
+    m_Display->ScrollLeft(4);
   }
 
   /* 00FD */
@@ -859,16 +1587,14 @@ namespace dorito {
 
   /* 00FE */
   void Chip8::ProcLores() {
-    auto &bus = Bus::Get();
     m_HighRes = false;
-    bus.SetHighRes(false);
+    m_Machine.SetHighRes(false);
   }
 
   /* 00FF */
   void Chip8::ProcHires() {
-    auto &bus = Bus::Get();
     m_HighRes = true;
-    bus.SetHighRes(true);
+    m_Machine.SetHighRes(true);
   }
 
   /* 1NNN */
@@ -878,8 +1604,7 @@ namespace dorito {
 
   /* 2NNN */
   void Chip8::ProcCall() {
-    auto &bus = Bus::Get();
-    bus.Push(regs.pc);
+    m_Ram->Push(regs.pc);
     regs.pc = mOperands[0].value;
   }
 
@@ -906,8 +1631,6 @@ namespace dorito {
 
   /* 5XY2 */
   void Chip8::ProcRegisterSave() {
-    auto &bus = Bus::Get();
-
     uint8_t x = mOperands[0].value;
     uint8_t y = mOperands[1].value;
 
@@ -915,19 +1638,17 @@ namespace dorito {
 
     if (x < y) {
       for (auto z = 0; z <= dist; z++) {
-        bus.Write(regs.i + z, regs.v[x + z]);
+        Write(regs.i + z, regs.v[x + z]);
       }
     } else {
       for (auto z = 0; z <= dist; z++) {
-        bus.Write(regs.i + z, regs.v[x - z]);
+        Write(regs.i + z, regs.v[x - z]);
       }
     }
   }
 
   /* 5XY3 */
   void Chip8::ProcRegisterLoad() {
-    auto &bus = Bus::Get();
-
     uint8_t x = mOperands[0].value;
     uint8_t y = mOperands[1].value;
 
@@ -935,11 +1656,11 @@ namespace dorito {
 
     if (x < y) {
       for (auto z = 0; z <= dist; z++) {
-        regs.v[x + z] = bus.Read(regs.i + z);
+        regs.v[x + z] = Load(regs.i + z);
       }
     } else {
       for (auto z = 0; z <= dist; z++) {
-        regs.v[x - z] = bus.Read(regs.i + z);
+        regs.v[x - z] = Load(regs.i + z);
       }
     }
   }
@@ -961,28 +1682,31 @@ namespace dorito {
   }
 
   /* 8XY1 */
+  template<uint16_t Q>
   void Chip8::ProcORReg() {
     regs.v[mOperands[0].value] |= regs.v[mOperands[1].value];
 
-    if (QuirkSet(Quirk::Logic)) {
+    if (QuirkSet<Q>(Quirk::Logic)) {
       regs.v[0xF] = 0;
     }
   }
 
   /* 8XY2 */
+  template<uint16_t Q>
   void Chip8::ProcANDReg() {
     regs.v[mOperands[0].value] &= regs.v[mOperands[1].value];
 
-    if (QuirkSet(Quirk::Logic)) {
+    if (QuirkSet<Q>(Quirk::Logic)) {
       regs.v[0xF] = 0;
     }
   }
 
   /* 8XY3 */
+  template<uint16_t Q>
   void Chip8::ProcXORReg() {
     regs.v[mOperands[0].value] ^= regs.v[mOperands[1].value];
 
-    if (QuirkSet(Quirk::Logic)) {
+    if (QuirkSet<Q>(Quirk::Logic)) {
       regs.v[0xF] = 0;
     }
   }
@@ -1004,11 +1728,12 @@ namespace dorito {
   }
 
   /* 8XY6 */
+  template<uint16_t Q>
   void Chip8::ProcShiftRight() {
     auto x = regs.v[mOperands[0].value];
     auto y = regs.v[mOperands[1].value];
 
-    if (QuirkSet(Quirk::Shift)) {
+    if (QuirkSet<Q>(Quirk::Shift)) {
       y = x;
     }
 
@@ -1026,11 +1751,12 @@ namespace dorito {
   }
 
   /* 8XYE */
+  template<uint16_t Q>
   void Chip8::ProcShiftLeft() {
     auto x = regs.v[mOperands[0].value];
     auto y = regs.v[mOperands[1].value];
 
-    if (QuirkSet(Quirk::Shift)) {
+    if (QuirkSet<Q>(Quirk::Shift)) {
       y = x;
     }
 
@@ -1051,8 +1777,9 @@ namespace dorito {
   }
 
   /* BNNN */
+  template<uint16_t Q>
   void Chip8::ProcJumpRelative() {
-    if (QuirkSet(Quirk::Jump))
+    if (QuirkSet<Q>(Quirk::Jump))
       regs.pc = mOperands[0].value + regs.v[(mOperands[0].value & 0xF00) >> 8];
     else
       regs.pc = regs.v[0] + mOperands[0].value;
@@ -1060,33 +1787,53 @@ namespace dorito {
 
   /* CXNN */
   void Chip8::ProcRandom() {
+    // Counts what the distribution takes so a snapshot can fast forward a copy of the engine
+    struct CountedEngine {
+      using result_type = std::mt19937::result_type;
+
+      std::mt19937 &engine;
+      uint64_t &draws;
+
+      static constexpr result_type min() { return std::mt19937::min(); }
+
+      static constexpr result_type max() { return std::mt19937::max(); }
+
+      result_type operator()() {
+        draws++;
+        return engine();
+      }
+    };
+
     std::uniform_int_distribution<int> dist(0, 255);
+    CountedEngine engine{mt, m_RandomDraws};
 
-    regs.v[mOperands[0].value] = dist(mt) & mOperands[1].value;
+    regs.v[mOperands[0].value] = dist(engine) & mOperands[1].value;
   }
 
   /* DXYN */
+  template<uint16_t Q>
   void Chip8::ProcDrawSprite() {
-    if (WaitForInterrupt()) {
+    if (WaitForInterrupt<Q>()) {
       return;
     }
 
-    auto &bus = Bus::Get();
-
     uint8_t x = regs.v[mOperands[0].value];
     uint8_t y = regs.v[mOperands[1].value];
     uint8_t height = mOperands[2].value;
     uint16_t i = regs.i;
 
-    uint8_t planeMask = bus.GetPlane();
+    uint8_t planeMask = m_Display->PlaneMask();
 
-    uint8_t dispWidth = bus.DisplayWidth();
-    uint8_t dispHeight = bus.DisplayHeight();
+    uint8_t dispWidth = m_Display->Width();
+    uint8_t dispHeight = m_Display->Height();
 
     uint8_t spriteWidth = height == 0 ? 16 : 8;
     uint8_t spriteHeight = height == 0 ? 16 : height;
 
-    if (QuirkSet(Quirk::LoresSprites)) {
+    const bool clip = QuirkSet<Q>(Quirk::Clip);
+    const bool loresSprites = QuirkSet<Q>(Quirk::LoresSprites);
+
+    if (loresSprites) {
       spriteWidth = 8;
     }
 
@@ -1110,43 +1857,49 @@ namespace dorito {
       if ((planeMask & (layer + 1)) == 0)
         continue;
 
-      for (uint8_t n = 0; n < spriteHeight; n++) {
-        uint16_t line = height == 0
-                        ? bus.Read((2 * n) + i) << 8 | bus.Read((2 * n) + i + 1)
-                        : bus.Read(i + n);
-
+      uint32_t patterns[Display::MaxSpriteRows];
 
-        /* Special Sprite height 0 handling when not in hires
-         * makes Hap's test rom work. Not sure if this ever shows up
-         * anywhere else. Made it a quirk.
-         */
+      if (m_Ram->GetWatchpoints().AnyArmed()) [[unlikely]] {
+        // Byte by byte through Load, so read watchpoints see what they did before
+        for (uint8_t n = 0; n < spriteHeight; n++) {
+          uint16_t line = height == 0
+                          ? Load((2 * n) + i) << 8 | Load((2 * n) + i + 1)
+                          : Load(i + n);
 
-        if (QuirkSet(Quirk::LoresSprites)) {
-          if (height == 0 && !m_HighRes)
-            line = bus.Read(i + n) << 8 | bus.Read(i + n + 1);
-        }
 
-        for (auto b = 0; b < spriteWidth; b++) {
-          uint8_t bit = height == 0
-                        ? 15 - b
-                        : 7 - b;
+          /* Special Sprite height 0 handling when not in hires
+           * makes Hap's test rom work. Not sure if this ever shows up
+           * anywhere else. Made it a quirk.
+           */
 
-          uint8_t pixel = (line & (1 << bit)) >> bit;
-
-          if (QuirkSet(Quirk::Clip) &&
-              (x + b >= dispWidth || y + n >= dispHeight)) {
-            pixel = 0;
+          if (loresSprites) {
+            if (height == 0 && !m_HighRes)
+              line = Load(i + n) << 8 | Load(i + n + 1);
           }
 
-          if (!pixel)
-            continue;
+          // A 16 wide row narrowed to 8 keeps its left half
+          patterns[n] = height == 0
+                        ? line >> (16 - spriteWidth)
+                        : line;
+        }
+      } else if (height != 0 || (loresSprites && !m_HighRes)) {
+        // One byte a row, the narrowed big sprite included
+        for (uint8_t n = 0; n < spriteHeight; n++) {
+          patterns[n] = m_Memory[static_cast<uint16_t>(i + n)];
+        }
+      } else {
+        for (uint8_t n = 0; n < spriteHeight; n++) {
+          uint16_t at = i + 2 * n;
+          uint16_t line = m_Memory[at] << 8 | m_Memory[static_cast<uint16_t>(at + 1)];
 
-          if (bus.Plot(layer, x + b, y + n)) {
-            collided = 1;
-          }
+          patterns[n] = line >> (16 - spriteWidth);
         }
       }
 
+      if (m_Display->DrawSprite(layer, x, y, patterns, spriteHeight, spriteWidth, clip)) {
+        collided = 1;
+      }
+
       i += (height == 0 ? 32 : height);
     }
 
@@ -1178,20 +1931,16 @@ namespace dorito {
 
   /* FN01 */
   void Chip8::ProcPlane() {
-    auto &bus = Bus::Get();
-
-    bus.SetPlane(mOperands[0].value);
+    m_Display->PlaneMask(mOperands[0].value);
   }
 
   /* F002 */
   void Chip8::ProcAudio() {
-    auto &bus = Bus::Get();
-
     for (auto n = regs.i; n < regs.i + 16; n++) {
-      bus.WriteAudio(n - regs.i, bus.Read(n));
+      m_Ram->WriteAudio(n - regs.i, Load(n));
     }
 
-    bus.UseBeepBuffer(false);
+    m_Machine.UseBeepBuffer(false);
   }
 
   /* FX07 */
@@ -1216,6 +1965,7 @@ namespace dorito {
   }
 
   /* FX1E */
+  template<uint16_t Q>
   void Chip8::ProcAddIWithReg() {
     /* This quirk makes Tronix's SC Chip test rom pass all tests.
      * Tronix offers the following explanation:
@@ -1228,7 +1978,7 @@ namespace dorito {
      *  https://github.com/metteo/chip8-test-rom
      */
 
-    if (QuirkSet(Quirk::IRegCarry)) {
+    if (QuirkSet<Q>(Quirk::IRegCarry)) {
       uint32_t sum = regs.i + regs.v[mOperands[0].value];
 
       regs.i = sum & 0xFFF;
@@ -1240,82 +1990,71 @@ namespace dorito {
 
   /* FX29 */
   void Chip8::ProcLoadISpriteAddr() {
-    auto &bus = Bus::Get();
-
-    regs.i = bus.CharacterAddress(regs.v[mOperands[0].value & 0xF]);
+    regs.i = m_Ram->CharacterAddress(regs.v[mOperands[0].value & 0xF]);
   }
 
   /* FX30 */
   void Chip8::ProcLoadIBigSpriteAddr() {
-    auto &bus = Bus::Get();
-    regs.i = bus.BigCharacterAddress(regs.v[mOperands[0].value] & 0xF);
+    regs.i = m_Ram->BigCharacterAddress(regs.v[mOperands[0].value] & 0xF);
   }
 
   /* FX33 */
   void Chip8::ProcLoadBCD() {
-    auto &bus = Bus::Get();
-
     // Unpacked NBCD
     uint8_t value = regs.v[mOperands[0].value];
 
-    bus.Write(regs.i, (value / 100) % 10);
-    bus.Write(regs.i + 1, (value / 10) % 10);
-    bus.Write(regs.i + 2, value % 10);
+    Write(regs.i, (value / 100) % 10);
+    Write(regs.i + 1, (value / 10) % 10);
+    Write(regs.i + 2, value % 10);
   }
 
   /* FX3A */
   void Chip8::ProcPitch() {
-    auto &bus = Bus::Get();
-
     // This is pretty much just voodoo to me... wish the spec went into more details.
     regs.pitch = 4000.0 * std::pow(2.0, (regs.v[mOperands[0].value] - 64.0) / 48.0);
     m_PitchDirty = true;
-    bus.UseBeepBuffer(false);
+    m_Machine.UseBeepBuffer(false);
   }
 
   /* FX55 */
+  template<uint16_t Q>
   void Chip8::ProcRegisterSaveIncrement() {
-    auto &bus = Bus::Get();
-
     uint8_t n = 0;
     uint8_t i = 0;
 
     do {
-      bus.Write(regs.i + i++, regs.v[n]);
+      Write(regs.i + i++, regs.v[n]);
       n++;
     } while (n <= mOperands[0].value);
 
-    if (!QuirkSet(Quirk::LoadStore))
+    if (!QuirkSet<Q>(Quirk::LoadStore))
       regs.i = (regs.i + mOperands[0].value + 1) & 0xFFFF;
   }
 
   /* FX65 */
+  template<uint16_t Q>
   void Chip8::ProcRegisterLoadIncrement() {
-    auto &bus = Bus::Get();
-
     uint8_t n = 0;
     uint8_t i = 0;
 
     do {
-      regs.v[n] = bus.Read(regs.i + i++);
+      regs.v[n] = Load(regs.i + i++);
       n++;
     } while (n <= mOperands[0].value);
 
-    if (!QuirkSet(Quirk::LoadStore))
+    if (!QuirkSet<Q>(Quirk::LoadStore))
       regs.i = (regs.i + mOperands[0].value + 1) & 0xFFFF;
   }
 
   /* FX75 */
   void Chip8::ProcSaveFlags() {
-    auto &bus = Bus::Get();
-
-    const auto &romPath = bus.Path();
+    const auto &romPath = m_Machine.Path();
     std::string path = romPath + ".flags";
 
     std::ofstream stream(path.c_str(), std::ios::binary);
 
     if (!stream.good()) {
-      spdlog::get("console")->warn("Couldn't save flags at: {}", path);
+      m_Machine.Warn(fmt::format("Couldn't save flags at: {}", path));
       return;
     }
 
@@ -1335,15 +2074,13 @@ namespace dorito {
 
   /* FX85 */
   void Chip8::ProcLoadFlags() {
-    auto &bus = Bus::Get();
-
-    const auto &romPath = bus.Path();
+    const auto &romPath = m_Machine.Path();
     std::string path = romPath + ".flags";
 
     std::ifstream stream(path.c_str(), std::ios::binary);
 
     if (!stream.good()) {
-      spdlog::get("console")->warn("Couldn't load flags at: {}", path);
+      m_Machine.Warn(fmt::format("Couldn't load flags at: {}", path));
       memset(regs.v, 0, 16);
       return;
     }
@@ -1370,8 +2107,9 @@ namespace dorito {
    * Thanks to Timendus for his test rom which showed the problem
    * to begin with as well.
    */
+  template<uint16_t Q>
   bool Chip8::WaitForInterrupt() {
-    if (!QuirkSet(Quirk::VBlank)) {
+    if (!QuirkSet<Q>(Quirk::VBlank)) {
       return false;
     }
 
@@ -5,9 +5,23 @@
 #include <map>
 #include <vector>
 #include <random>
+#include <algorithm>
+
+#include <fmt/format.h>
+
+#include "common/common.h"
+#include "cpu/Breakpoints.h"
+#include "cpu/Memory.h"
+#include "cpu/Profiler.h"
+#include "cpu/Tracer.h"
+#include "display/Display.h"
 
 namespace dorito {
 
+  class Machine;
+
+  class Recompiler;
+
   class Chip8 {
   public:
     using InstructionProc = void (Chip8::*)();
@@ -23,12 +37,74 @@ namespace dorito {
       IRegCarry
     };
 
-    struct Breakpoint {
-      std::string label;
-      uint16_t addr;
-      bool enabled;
+    /* The compatibility profiles as quirk masks (bit n is Quirk n),
+     * each gets its own copy of the quirk dependent handlers.
+     */
+    static constexpr uint16_t VIPQuirks = 0x54;   // Clip, Logic, VBlank
+    static constexpr uint16_t SCHIPQuirks = 0x0F; // Shift, LoadStore, Clip, Jump
+    static constexpr uint16_t XOChipQuirks = 0x00;
+
+    // Any other mix runs handlers that check regs.quirks
+    static constexpr uint16_t CustomQuirks = 0x100;
+
+    // One entry per Proc* handler, in declaration order
+    enum class Op : uint8_t {
+      Unimplemented,
+      ClearScreen,
+      Return,
+      Jump,
+      Call,
+      SkipEqualsLiteral,
+      SkipNotEqualsLiteral,
+      SkipRegEqualsReg,
+      LoadLiteral,
+      AddLiteral,
+      LoadRegister,
+      ORReg,
+      ANDReg,
+      XORReg,
+      Add,
+      SubtractYFromX,
+      ShiftRight,
+      SubtractXFromY,
+      ShiftLeft,
+      SkipRegNotEqualReg,
+      LoadILiteral,
+      LoadIExtended,
+      JumpRelative,
+      Random,
+      DrawSprite,
+      SkipKeyPressed,
+      SkipKeyNotPressed,
+      LoadDelayToReg,
+      LoadKeypressToReg,
+      LoadRegToDelay,
+      LoadRegToBuzzer,
+      AddIWithReg,
+      LoadISpriteAddr,
+      LoadBCD,
+      RegisterSaveIncrement,
+      RegisterLoadIncrement,
+      SaveFlags,
+      LoadFlags,
+      Exit,
+      LoadIBigSpriteAddr,
+      Hires,
+      Lores,
+      ScrollDown,
+      ScrollRight,
+      ScrollLeft,
+      ScrollUp,
+      Plane,
+      RegisterSave,
+      RegisterLoad,
+      Pitch,
+      Audio,
+      Count
     };
 
+    using Breakpoint = dorito::Breakpoint;
+
     struct Registers {
       // General purpose registers
       uint8_t v[16];
@@ -54,14 +130,29 @@ namespace dorito {
 
       // Quirks
       bool quirks[8];
+    };
 
-      // Breakpoints
-      std::vector<Breakpoint> breakpoints;
+    // Everything about the CPU a snapshot of the machine needs, less the random engine
+    struct State {
+      Registers regs;
+      uint64_t cycles;
+
+      // Draws taken from the random engine since it was seeded
+      uint64_t randomDraws;
+
+      bool waiting;
+      bool highRes;
+      bool pitchDirty;
+      uint8_t keyPressRegister;
+      uint8_t waitForInterrupt;
     };
 
+    // Entry point of a recompiled block, returns how many ops it retired
+    using NativeBlock = uint32_t (*)(Chip8 *cpu, Registers *regs);
+
     struct DisassemblyLine {
       uint16_t addr;
-      uint16_t index;
+      uint8_t length;
       std::string text;
       std::string bytes;
     };
@@ -79,34 +170,168 @@ namespace dorito {
       uint16_t value;
     };
 
+    /* A piece of a label, its text followed by the operand that goes
+     * after it. The last piece of a label has no operand.
+     */
+    struct LabelPart {
+      std::string text;
+      int8_t operand;
+    };
+
     struct Instruction {
       uint16_t code;
       std::string encoding;
       std::string label;
       uint8_t operand_count;
       OperandType operand_order[3];
-      InstructionProc proc;
+      Op op;
+
+      // The label split around its operands, built once by CompileLabels
+      std::vector<LabelPart> parts{};
+    };
+
+    struct DecodedInstruction {
+      Instruction *instruction;
+      uint16_t latch;
+      uint8_t length;
+      bool valid;
+      Operand operands[3];
+    };
+
+    struct BlockOp {
+      Op op;
+      uint16_t addr;
+      uint16_t next;
+      uint16_t latch;
+      Instruction *instruction;
+      Operand operands[3];
+    };
+
+    /* A straight-line run of instructions ending at the first one
+     * that may leave it (jumps, calls, skips, returns, draws...).
+     */
+    struct Block {
+      uint16_t start;
+      uint32_t end;
+      bool valid;
+      std::vector<BlockOp> ops;
+
+      // Last two successors, checked before going back to the block table
+      Block *links[2];
+      uint8_t nextLink;
+
+      // Recompiled code, built once the block has run m_JitThreshold times
+      NativeBlock native;
+      uint16_t heat;
+      bool nativeRejected;
     };
 
   public:
-    Chip8();
+    explicit Chip8(Machine &machine);
+
+    ~Chip8();
+
+    // Called by the Machine once its RAM and display exist
+    void Attach(Memory &ram, Display &display) {
+      m_Ram = &ram;
+      m_Display = &display;
+      m_Memory = ram.Data();
+    }
 
     void Reset();
 
     void Tick(uint32_t cycles);
 
+    // Tick one instruction at a time, stopping short once pc reaches addr. True if it did
+    bool TickUntil(uint16_t addr, uint32_t cycles);
+
     void Step();
 
     void TickTimers();
 
+    void InvalidateDecoded(uint16_t addr) {
+      // An F000 instruction spans 4 bytes so any of the 3 preceding entries may cover addr
+      for (uint8_t n = 0; n < 4; n++) {
+        m_DecodeCache[static_cast<uint16_t>(addr - n)].valid = false;
+      }
+
+      if (m_CodePages[addr >> 8])
+        InvalidateBlocks(addr);
+
+      // Disassembled code was overwritten, walk it again next UpdateDisassembly
+      if (m_DisassemblyEnabled && m_Analyzed[addr] && !m_DisassemblyStale[addr]) {
+        m_DisassemblyStale[addr] = true;
+        m_StaleCode.push_back(addr);
+      }
+    }
+
+    // InvalidateDecoded over [from, to) in one pass, for restoring whole pages
+    void InvalidateRange(uint16_t from, uint32_t to);
+
+    void FlushDecoded();
+
+    /* The disassembly is only kept while a debugger view wants it.
+     * Turning it on walks everything reachable from 0x200, after that
+     * code is added as it is first run or rewritten.
+     */
+    void DisassemblyEnabled(bool isEnabled);
+
+    [[nodiscard]] bool DisassemblyEnabled() const { return m_DisassemblyEnabled; }
+
+    // Starts the disassembly over from 0x200, after a new program is loaded
+    void Analyze();
+
+    // Walks again any disassembled code written since the last call, and sorts in what was discovered
+    void UpdateDisassembly();
+
+    // One row per line, sorted by address
+    [[nodiscard]] const std::vector<DisassemblyLine> &Disassembly() const { return m_Disassembly; }
+
+    // Row of the line at addr, or the closest one before it. -1 when there is none
+    [[nodiscard]] int32_t DisassemblyRow(uint16_t addr) const;
+
+    void Threaded(bool isThreaded) {
+      m_Threaded = isThreaded;
+    }
+
+    void Jit(bool isSet);
+
+    void JitChecked(bool isChecked) {
+      m_JitChecked = isChecked;
+    }
+
+    void Seed(uint32_t seed) {
+      mt.seed(seed);
+      m_RandomDraws = 0;
+    }
+
     void Halted(bool isHalted) {
       m_Halted = isHalted;
     }
 
+    void BreakpointHit(bool isHit) {
+      m_BreakpointHit = isHit;
+    }
+
     std::string OperandTypeName(const OperandType &type) {
       return m_OpTypeLabels[type];
     }
 
+    [[nodiscard]] State GetState() const;
+
+    // Leaves the CPU halted or not as it is, and the decode cache to whoever restores memory
+    void SetState(const State &state);
+
+    [[nodiscard]] const std::mt19937 &RandomEngine() const { return mt; }
+
+    void RandomEngine(const std::mt19937 &engine) { mt = engine; }
+
+    /* Runs count instructions exactly as a frame would have, without
+     * stopping for breakpoints, watchpoints or tracing. For going back
+     * over instructions that already ran once.
+     */
+    void Replay(uint64_t count);
+
     void SetKeyState(uint8_t key, bool state) {
       regs.keys[key & 0xF] = state;
     }
@@ -122,46 +347,84 @@ namespace dorito {
       for (const auto &quirk: quirks) {
         regs.quirks[static_cast<uint8_t>(quirk)] = isSet;
       }
+
+      SyncQuirks();
+    }
+
+    // Bit n is Quirk n
+    void SetQuirks(uint8_t mask) {
+      for (uint8_t n = 0; n < 8; n++) {
+        regs.quirks[n] = (mask >> n) & 1;
+      }
+
+      SyncQuirks();
     }
 
     void SetHighRes(bool isSet) {
       m_HighRes = isSet;
     }
 
-    void AddBreakpoint(const Breakpoint &bp) {
-      regs.breakpoints.push_back(bp);
+    // Empty when added, otherwise why its condition didn't compile
+    std::string AddBreakpoint(const Breakpoint &bp) {
+      return m_Breakpoints.Add(bp);
     }
 
     void ToggleBreakpoint(const Breakpoint &breakpoint) {
-      for (auto &bp: regs.breakpoints) {
-        if (bp.label == breakpoint.label) {
-          bp.enabled = !bp.enabled;
-          break;
-        }
-      }
+      m_Breakpoints.Toggle(breakpoint.label);
     }
 
     void RemoveBreakpoint(const Breakpoint &breakpoint) {
-      std::vector<Breakpoint> newBps;
-
-      for (const auto &bp: regs.breakpoints) {
-        if (bp.label != breakpoint.label)
-          newBps.push_back(bp);
-      }
-
-      regs.breakpoints = newBps;
+      m_Breakpoints.Remove(breakpoint.label);
     }
 
     void ClearBreakpoints() {
-      regs.breakpoints.clear();
+      m_Breakpoints.Clear();
+    }
+
+    // Empty when set, otherwise why the condition didn't compile
+    std::string SetBreakpointCondition(const Breakpoint &breakpoint, const std::string &condition, uint32_t hitTarget) {
+      return m_Breakpoints.SetCondition(breakpoint.label, condition, hitTarget);
     }
 
     [[nodiscard]] const std::vector<Breakpoint> &Breakpoints() const {
-      return regs.breakpoints;
+      return m_Breakpoints.List();
+    }
+
+    // Tracing runs everything through Step, like armed breakpoints do
+    Tracer &GetTracer() {
+      return m_Tracer;
+    }
+
+    Profiler &GetProfiler() {
+      return m_Profiler;
     }
 
+    // The handler's name, for anything listing opcode classes
+    static const char *OpName(Op op);
+
     [[nodiscard]] bool Halted() const { return m_Halted; }
 
+    [[nodiscard]] bool Waiting() const { return m_Waiting; }
+
+    [[nodiscard]] uint64_t Cycles() const { return m_Cycles; }
+
+    // Set when execution stopped on a breakpoint, cleared by whoever reacts to it
+    [[nodiscard]] bool BreakpointHit() const { return m_BreakpointHit; }
+
+    [[nodiscard]] bool Threaded() const { return m_Threaded; }
+
+    [[nodiscard]] bool Jit() const { return m_Jit; }
+
+    [[nodiscard]] bool JitChecked() const { return m_JitChecked; }
+
+    [[nodiscard]] static constexpr bool JitAvailable() {
+#if defined(DORITO_JIT)
+      return true;
+#else
+      return false;
+#endif
+    }
+
     [[nodiscard]] std::vector<bool> GetQuirks() const {
       std::vector<bool> result;
       for (bool quirk: regs.quirks)
@@ -173,20 +436,113 @@ namespace dorito {
   private:
     void Fetch();
 
-    void ExtractOperands(uint16_t opcode, Instruction *current, bool advancePC);
+    void ExtractOperands(uint16_t addr, uint16_t opcode, Instruction *current, Operand *operands);
+
+    DecodedInstruction &DecodeAt(uint16_t addr);
+
+    void RunThreaded(uint32_t cycles);
+
+    Block &LookupBlock(uint16_t addr);
+
+    void TranslateBlock(uint16_t addr, Block &block);
+
+    uint32_t RunBlock(Block &block);
+
+    uint32_t ExecuteBlock(Block &block) {
+      return (this->*m_ExecuteBlock)(block);
+    }
+
+    template<uint16_t Q>
+    uint32_t Execute(Block &block);
+
+    void SyncQuirks();
+
+    template<uint16_t Q>
+    void UseQuirks();
+
+    template<uint16_t Q>
+    static const InstructionProc *ProcTable();
+
+    void Enter(const BlockOp &op) {
+      m_PrevPC = op.addr;
+      regs.latch = op.latch;
+      regs.pc = op.next;
+      m_CurrentInstruction = op.instruction;
+      std::copy_n(op.operands, 3, mOperands);
+    }
+
+    void FlushNative();
+
+    void InvalidateBlocks(uint16_t addr);
 
     Instruction *Decode(uint16_t code, bool silent = false);
 
-    void DisassembleNext();
+    Instruction *DecodeInstruction(uint16_t code);
+
+    void BuildDecodeTable();
+
+    void Disassemble(uint16_t addr);
+
+    void CompileLabels();
+
+    static void FormatOperand(fmt::memory_buffer &out, const Operand &operand);
+
+    // Disassembles addr and everything statically reachable from it, IndexDisassembly sorts them in after
+    void DisassembleFrom(uint16_t addr);
+
+    /* Picks up code only ever reached through a computed jump or return.
+     * Sorting it in scans the whole address space, so that waits for the
+     * next UpdateDisassembly rather than holding up the fetch.
+     */
+    void Discover(uint16_t addr) {
+      if (m_DisassemblyEnabled && !m_Analyzed[addr])
+        DisassembleFrom(addr);
+    }
+
+    void ClearDisassembly();
+
+    void IndexDisassembly();
 
     void SetFlag(uint8_t dest, uint16_t value, bool isSet);
 
+    // Only called once the armed bit for regs.pc is set
+    bool BreakpointStops();
+
+    // Breakpoints, watchpoints and the tracer all need to see every instruction
+    [[nodiscard]] bool MustStep() const {
+      return m_Breakpoints.AnyArmed() || m_Ram->GetWatchpoints().AnyArmed() || m_Tracer.Enabled();
+    }
+
     void Skip();
 
-    bool QuirkSet(const Quirk &quirk) {
-      return regs.quirks[static_cast<uint8_t>(quirk)];
+    // Decoding and disassembly look at code, never tripping watchpoints
+    uint8_t Read(uint16_t addr) const {
+      return m_Memory[addr];
+    }
+
+    // Data reads by instructions, which watchpoints see
+    uint8_t Load(uint16_t addr) {
+      return m_Ram->Read(addr);
+    }
+
+    void Write(uint16_t addr, uint8_t data) {
+      // Memory counts the fault below 0x200 and checks watchpoints
+      m_Ram->Write(addr, data);
+
+      if (addr >= 0x200)
+        InvalidateDecoded(addr);
     }
 
+    // Folds to a constant for the profile specializations
+    template<uint16_t Q>
+    [[nodiscard]] bool QuirkSet(Quirk quirk) const {
+      if constexpr (Q == CustomQuirks)
+        return regs.quirks[static_cast<uint8_t>(quirk)];
+      else
+        return (Q >> static_cast<uint8_t>(quirk)) & 1;
+    }
+
+    template<uint16_t Q>
     bool WaitForInterrupt();
 
   private:
@@ -212,20 +568,25 @@ namespace dorito {
 
     void ProcLoadRegister();
 
+    template<uint16_t Q>
     void ProcORReg();
 
+    template<uint16_t Q>
     void ProcANDReg();
 
+    template<uint16_t Q>
     void ProcXORReg();
 
     void ProcAdd();
 
     void ProcSubtractYFromX();
 
+    template<uint16_t Q>
     void ProcShiftRight();
 
     void ProcSubtractXFromY();
 
+    template<uint16_t Q>
     void ProcShiftLeft();
 
     void ProcSkipRegNotEqualReg();
@@ -234,10 +595,12 @@ namespace dorito {
 
     void ProcLoadIExtended();
 
+    template<uint16_t Q>
     void ProcJumpRelative();
 
     void ProcRandom();
 
+    template<uint16_t Q>
     void ProcDrawSprite();
 
     void ProcSkipKeyPressed();
@@ -252,14 +615,17 @@ namespace dorito {
 
     void ProcLoadRegToBuzzer();
 
+    template<uint16_t Q>
     void ProcAddIWithReg();
 
     void ProcLoadISpriteAddr();
 
     void ProcLoadBCD();
 
+    template<uint16_t Q>
     void ProcRegisterSaveIncrement();
 
+    template<uint16_t Q>
     void ProcRegisterLoadIncrement();
 
     void ProcSaveFlags();
@@ -303,9 +669,45 @@ namespace dorito {
 
     friend class Bus;
 
+    friend class Recompiler;
+
   private:
+    Machine &m_Machine;
+
+    // Straight to the hardware for the handlers, RAM spans all 64K
+    Memory *m_Ram = nullptr;
+    Display *m_Display = nullptr;
+    uint8_t *m_Memory = nullptr;
+
     std::map<uint16_t, Instruction> m_Instructions;
 
+    // Every possible opcode mapped straight to its instruction
+    std::vector<Instruction *> m_DecodeTable = std::vector<Instruction *>(0x10000);
+    Instruction *m_InvalidInstruction = nullptr;
+
+    // Fully decoded instructions keyed by address, invalidated on writes
+    std::vector<DecodedInstruction> m_DecodeCache = std::vector<DecodedInstruction>(0x10000);
+
+    // Translated blocks keyed by start address, plus which 256 byte pages hold any
+    static constexpr uint8_t m_MaxBlockLength = 32;
+    std::vector<Scope<Block>> m_Blocks = std::vector<Scope<Block>>(0x10000);
+    std::vector<bool> m_CodePages = std::vector<bool>(0x100);
+
+    bool m_Threaded = true;
+
+    // Handlers specialized for the current quirks, switched by SyncQuirks
+    uint16_t m_QuirkSet = CustomQuirks;
+    const InstructionProc *m_Procs = nullptr;
+    uint32_t (Chip8::*m_ExecuteBlock)(Block &block) = nullptr;
+
+    // Recompiler for hot blocks, only built on x86-64 Linux
+    static constexpr uint16_t m_JitThreshold = 16;
+#if defined(DORITO_JIT)
+    Scope<Recompiler> m_Recompiler;
+#endif
+    bool m_Jit = false;
+    bool m_JitChecked = false;
+
     std::map<OperandType, std::string> m_OpTypeLabels{
         {OperandType::Register,    "Register"},
         {OperandType::Number4bit,  "Number4bit"},
@@ -320,19 +722,43 @@ namespace dorito {
 
     Instruction *m_CurrentInstruction = nullptr;
 
-    uint32_t m_Cycles = 0;
+    // Instructions executed since reset
+    uint64_t m_Cycles = 0;
+
+    dorito::Breakpoints m_Breakpoints;
+
+    Tracer m_Tracer;
+    Profiler m_Profiler;
+
+    // Where execution stopped on a breakpoint, so resuming doesn't stop there again
+    int32_t m_ResumeFrom = -1;
 
     bool m_Halted = true;
+    bool m_BreakpointHit = false;
     bool m_Waiting = false;
     bool m_HighRes = false;
     bool m_PitchDirty = false;
 
-    std::map<uint16_t, DisassemblyLine> m_Disassembly;
-    uint16_t m_DisasmCount = 0;
+    /* Lines sorted by address up to m_IndexedLines, anything after that
+     * was added by a walk and not sorted in yet. m_DisassemblyRows maps
+     * the address each line starts at back to its row, -1 for none.
+     */
+    std::vector<DisassemblyLine> m_Disassembly;
+    size_t m_IndexedLines = 0;
+    std::vector<int32_t> m_DisassemblyRows = std::vector<int32_t>(0x10000, -1);
+    fmt::memory_buffer m_DisassemblyText;
     uint16_t m_PrevPC = 0x200;
 
+    bool m_DisassemblyEnabled = false;
+
+    // Bytes covered by a disassembled instruction, and those since written over
+    std::vector<bool> m_Analyzed = std::vector<bool>(0x10000);
+    std::vector<bool> m_DisassemblyStale = std::vector<bool>(0x10000);
+    std::vector<uint16_t> m_StaleCode;
+
     std::random_device rd;
     std::mt19937 mt{rd()};
+    uint64_t m_RandomDraws = 0;
 
     uint8_t m_KeyPressRegister = 0;
 
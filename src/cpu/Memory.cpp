@@ -1,9 +1,9 @@
 #include "Memory.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 
-#include "core/events/EventManager.h"
-
 namespace dorito {
   Memory::Memory() {
     Reset();
@@ -28,27 +28,21 @@ namespace dorito {
     stream.read(&contents[0], static_cast<std::streamsize>(position));
     stream.close();
 
-    auto data = std::vector<uint8_t>(contents.begin(), contents.end());
-
-    m_RomSize = data.size();
+    m_RomSize = contents.size();
 
     uint16_t addr = 0x200;
 
-    for (uint8_t b: data) {
-      m_Ram[addr++] = b;
+    for (char b: contents) {
+      m_Ram[addr++] = static_cast<uint8_t>(b);
     }
   }
 
   void Memory::LoadRom(const char *rom) {
     Reset();
 
-    uint16_t addr = 0x200;
-
-    for (auto i = 0; i < 1024 * 64; i++) {
-      m_Ram[addr + i] = rom[addr + i];
+    for (uint32_t addr = 0x200; addr < m_MemorySize; addr++) {
+      m_Ram[addr] = rom[addr];
     }
-
-
   }
 
   void Memory::Reset() {
@@ -58,6 +52,12 @@ namespace dorito {
 
     m_UseBeep = true;
 
+    m_StackUnderflows = 0;
+    m_OutOfRangeWrites = 0;
+    m_LastOutOfRangeWrite = 0;
+
+    m_Watchpoints.ClearTriggered();
+
     LoadFont();
   }
 
@@ -67,12 +67,15 @@ namespace dorito {
   }
 
   void Memory::Push(uint16_t addr) {
+    if (m_Stack.size() >= StackLimit)
+      m_Stack.pop_back();
+
     m_Stack.push_front(addr);
   }
 
   uint16_t Memory::Pop() {
     if (m_Stack.empty()) {
-      EventManager::Dispatcher().enqueue(Events::StackUnderflow{});
+      m_StackUnderflows++;
       return 0;
     }
 
@@ -82,21 +85,13 @@ namespace dorito {
     return result;
   }
 
-  void Memory::Write(uint16_t addr, uint8_t data) {
-    if (addr < 0x200) {
-      EventManager::Dispatcher().enqueue(Events::OutOfRangeMemAccess{addr});
-      return;
-    }
-
-    m_Ram[addr] = data;
-  }
-
   void Memory::WriteAudio(uint8_t position, uint8_t data) {
-    m_AudioBuffer[position & 0xF] = data;
-  }
+    position &= 0xF;
+
+    if (m_Watchpoints.AudioFlags() & Watchpoint::Write)
+      m_Watchpoints.Check<Watchpoint::Write>(Watchpoint::Space::Audio, position, m_AudioBuffer[position], data);
 
-  uint8_t Memory::Read(uint16_t addr) {
-    return m_Ram[addr];
+    m_AudioBuffer[position] = data;
   }
 
   uint16_t Memory::CharacterAddress(uint8_t character) {
@@ -6,9 +6,17 @@
 #include <vector>
 #include <string>
 
+#include "Watchpoints.h"
+
 namespace dorito {
 
   class Memory {
+  public:
+    // Deepest the call stack goes, pushing past it forgets the oldest return address
+    static constexpr size_t StackLimit = 0xFFFF;
+
+    static constexpr size_t AudioPatternSize = 16;
+
   public:
     Memory();
 
@@ -22,11 +30,32 @@ namespace dorito {
 
     uint16_t Pop();
 
-    void Write(uint16_t addr, uint8_t data);
+    void Write(uint16_t addr, uint8_t data) {
+      if (addr < 0x200) {
+        m_OutOfRangeWrites++;
+        m_LastOutOfRangeWrite = addr;
+        return;
+      }
+
+      if (m_Watchpoints.PageFlags(addr) & Watchpoint::Write) [[unlikely]]
+        m_Watchpoints.Check<Watchpoint::Write>(Watchpoint::Space::Ram, addr, m_Ram[addr], data);
+
+      m_Ram[addr] = data;
+    }
 
     void WriteAudio(uint8_t position, uint8_t data);
 
-    uint8_t Read(uint16_t addr);
+    // RAM covers the whole 16-bit address space so any address is in bounds
+    uint8_t Read(uint16_t addr) {
+      if (m_Watchpoints.PageFlags(addr) & Watchpoint::Read) [[unlikely]]
+        m_Watchpoints.Check<Watchpoint::Read>(Watchpoint::Space::Ram, addr, m_Ram[addr], m_Ram[addr]);
+
+      return m_Ram[addr];
+    }
+
+    Watchpoints &GetWatchpoints() {
+      return m_Watchpoints;
+    }
 
     uint16_t CharacterAddress(uint8_t character);
 
@@ -42,6 +71,11 @@ namespace dorito {
       m_UseBeep = use;
     }
 
+    // The XO-Chip pattern itself, whether or not the beep is playing instead
+    std::vector<uint8_t> &AudioPattern() {
+      return m_AudioBuffer;
+    }
+
     std::deque<uint16_t> &GetStack() {
       return m_Stack;
     }
@@ -50,11 +84,42 @@ namespace dorito {
       return m_Ram;
     }
 
+    // Never reallocated, so safe to hold on to for the life of the Memory
+    uint8_t *Data() {
+      return m_Ram.data();
+    }
+
+    // Faults since the last reset, the app turns these into events
+    [[nodiscard]] uint32_t StackUnderflows() const { return m_StackUnderflows; }
+
+    [[nodiscard]] uint32_t OutOfRangeWrites() const { return m_OutOfRangeWrites; }
+
+    [[nodiscard]] uint16_t LastOutOfRangeWrite() const { return m_LastOutOfRangeWrite; }
+
+    // All the fault counts at once, for undoing a run that is about to be replayed
+    struct Faults {
+      uint32_t stackUnderflows = 0;
+      uint32_t outOfRangeWrites = 0;
+      uint16_t lastOutOfRangeWrite = 0;
+
+      bool operator==(const Faults &other) const = default;
+    };
+
+    [[nodiscard]] Faults SaveFaults() const {
+      return {m_StackUnderflows, m_OutOfRangeWrites, m_LastOutOfRangeWrite};
+    }
+
+    void RestoreFaults(const Faults &faults) {
+      m_StackUnderflows = faults.stackUnderflows;
+      m_OutOfRangeWrites = faults.outOfRangeWrites;
+      m_LastOutOfRangeWrite = faults.lastOutOfRangeWrite;
+    }
+
   private:
     void LoadFont();
 
   private:
-    static constexpr uint16_t m_MemorySize = 0xFFFF;
+    static constexpr uint32_t m_MemorySize = 0x10000;
 
   private:
     friend class UI;
@@ -104,12 +169,19 @@ namespace dorito {
     };
 
     std::vector<uint8_t> m_Ram = std::vector<uint8_t>(m_MemorySize);
-    std::vector<uint8_t> m_AudioBuffer = std::vector<uint8_t>(16);
+    std::vector<uint8_t> m_AudioBuffer = std::vector<uint8_t>(AudioPatternSize);
     std::deque<uint16_t> m_Stack;
 
+    // Kept across resets like breakpoints are
+    Watchpoints m_Watchpoints;
+
     uint16_t m_RomSize = 0;
 
     bool m_UseBeep = true;
+
+    uint32_t m_StackUnderflows = 0;
+    uint32_t m_OutOfRangeWrites = 0;
+    uint16_t m_LastOutOfRangeWrite = 0;
   };
 
 } // dorito
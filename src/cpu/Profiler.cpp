@@ -0,0 +1,65 @@
+#include "Profiler.h"
+
+#include <fstream>
+
+#include <fmt/format.h>
+
+namespace dorito {
+  void Profiler::Enable(bool isEnabled, uint64_t cycles) {
+    m_Enabled = isEnabled;
+    m_FrameStart = cycles;
+
+    if (isEnabled && m_Counts.empty())
+      m_Counts.assign(0x10000, 0);
+  }
+
+  void Profiler::Clear() {
+    std::fill(m_Counts.begin(), m_Counts.end(), 0);
+    m_OpCounts.fill(0);
+
+    m_Frames = 0;
+    m_Instructions = 0;
+    m_LastFrame = 0;
+    m_PeakFrame = 0;
+  }
+
+  uint64_t Profiler::Hottest() const {
+    return m_Counts.empty() ? 0 : *std::max_element(m_Counts.begin(), m_Counts.end());
+  }
+
+  std::string Profiler::SaveCsv(const std::string &path,
+                                const std::function<const char *(uint8_t)> &opName) const {
+    std::ofstream stream(path);
+
+    if (!stream.good())
+      return fmt::format("Couldn't open {} for writing", path);
+
+    auto perFrame = [this](uint64_t count) {
+      return m_Frames > 0 ? static_cast<double>(count) / static_cast<double>(m_Frames) : 0.0;
+    };
+
+    auto share = [this](uint64_t count) {
+      return m_Instructions > 0 ? 100.0 * static_cast<double>(count) / static_cast<double>(m_Instructions) : 0.0;
+    };
+
+    stream << "kind,key,executions,per_frame,percent\n";
+
+    for (uint32_t pc = 0; pc < m_Counts.size(); pc++) {
+      if (m_Counts[pc] > 0) {
+        stream << fmt::format("address,{:04X},{},{:.2f},{:.3f}\n",
+                              pc, m_Counts[pc], perFrame(m_Counts[pc]), share(m_Counts[pc]));
+      }
+    }
+
+    for (uint32_t op = 0; op < OpClasses; op++) {
+      if (m_OpCounts[op] > 0) {
+        stream << fmt::format("opcode,{},{},{:.2f},{:.3f}\n",
+                              opName(static_cast<uint8_t>(op)), m_OpCounts[op], perFrame(m_OpCounts[op]),
+                              share(m_OpCounts[op]));
+      }
+    }
+
+    return stream.good() ? std::string{} : fmt::format("Couldn't write {}", path);
+  }
+
+} // dorito
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace dorito {
+
+  /* Executions per address and per opcode class, and how many
+   * instructions each frame took. Counting is one increment per
+   * instruction into a flat table, so it stays on with the threaded
+   * interpreter and the recompiler rather than forcing single steps.
+   */
+  class Profiler {
+  public:
+    static constexpr size_t OpClasses = 256;
+
+  public:
+    [[nodiscard]] bool Enabled() const { return m_Enabled; }
+
+    // Keeps what was counted so far, cycles is where the current frame starts from
+    void Enable(bool isEnabled, uint64_t cycles);
+
+    void Clear();
+
+    void Count(uint16_t pc, uint8_t op) {
+      m_Counts[pc]++;
+      m_OpCounts[op]++;
+    }
+
+    // Once per 60Hz tick, frames where nothing ran aren't counted
+    void EndFrame(uint64_t cycles) {
+      // Rewound or reset underneath us, start over from here
+      if (cycles < m_FrameStart) {
+        m_FrameStart = cycles;
+        return;
+      }
+
+      auto ran = cycles - m_FrameStart;
+      m_FrameStart = cycles;
+
+      if (ran == 0)
+        return;
+
+      m_Frames++;
+      m_Instructions += ran;
+      m_LastFrame = ran;
+      m_PeakFrame = std::max(m_PeakFrame, ran);
+    }
+
+    [[nodiscard]] uint64_t At(uint16_t pc) const {
+      return m_Counts.empty() ? 0 : m_Counts[pc];
+    }
+
+    // One per address, empty until the profiler is first enabled
+    [[nodiscard]] const std::vector<uint64_t> &Counts() const { return m_Counts; }
+
+    [[nodiscard]] const std::array<uint64_t, OpClasses> &OpCounts() const { return m_OpCounts; }
+
+    // Largest count of any address, for scaling heat
+    [[nodiscard]] uint64_t Hottest() const;
+
+    // 0 to 1 on a log scale, so a hot loop doesn't wash out everything else
+    [[nodiscard]] static float Heat(uint64_t count, uint64_t hottest) {
+      if (count == 0 || hottest == 0)
+        return 0.0f;
+
+      return static_cast<float>(std::log1p(static_cast<double>(count)) / std::log1p(static_cast<double>(hottest)));
+    }
+
+    [[nodiscard]] uint64_t Frames() const { return m_Frames; }
+
+    [[nodiscard]] uint64_t Instructions() const { return m_Instructions; }
+
+    [[nodiscard]] uint64_t LastFrame() const { return m_LastFrame; }
+
+    [[nodiscard]] uint64_t PeakFrame() const { return m_PeakFrame; }
+
+    /* Every address that ran and every opcode class, with executions and
+     * the average per frame. Returns an empty string on success.
+     */
+    [[nodiscard]] std::string SaveCsv(const std::string &path,
+                                      const std::function<const char *(uint8_t)> &opName) const;
+
+  private:
+    std::vector<uint64_t> m_Counts;
+    std::array<uint64_t, OpClasses> m_OpCounts{};
+
+    uint64_t m_FrameStart = 0;
+    uint64_t m_Frames = 0;
+    uint64_t m_Instructions = 0;
+    uint64_t m_LastFrame = 0;
+    uint64_t m_PeakFrame = 0;
+
+    bool m_Enabled = false;
+  };
+
+} // dorito
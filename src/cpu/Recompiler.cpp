@@ -0,0 +1,494 @@
+#include "Recompiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+#include <fmt/format.h>
+
+#include "system/Machine.h"
+
+namespace dorito {
+
+  namespace {
+
+    // Flag files live on disk, a checked run would write or read them twice
+    bool ReachesOutside(const Chip8::Block &block) {
+      return std::any_of(block.ops.begin(), block.ops.end(), [](const Chip8::BlockOp &op) {
+        return op.op == Chip8::Op::SaveFlags || op.op == Chip8::Op::LoadFlags;
+      });
+    }
+
+    /* Just enough of an x86-64 assembler for the ops we recompile.
+     * Register use inside a block:
+     *   rbx - Chip8::Registers, every field is addressed off it
+     *   r12 - I, written back around call outs and on exit
+     *   r13 - the Chip8 instance, handed to call outs
+     *   rax, rcx - scratch
+     */
+    class Assembler {
+    public:
+      void Emit(std::initializer_list<uint8_t> bytes) {
+        m_Code.insert(m_Code.end(), bytes);
+      }
+
+      void Emit16(uint16_t value) {
+        Emit({static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)});
+      }
+
+      void Emit32(uint32_t value) {
+        for (uint8_t n = 0; n < 4; n++) {
+          m_Code.push_back(static_cast<uint8_t>(value >> (n * 8)));
+        }
+      }
+
+      void Emit64(uint64_t value) {
+        Emit32(static_cast<uint32_t>(value));
+        Emit32(static_cast<uint32_t>(value >> 32));
+      }
+
+      void Patch32(size_t at, uint32_t value) {
+        for (uint8_t n = 0; n < 4; n++) {
+          m_Code[at + n] = static_cast<uint8_t>(value >> (n * 8));
+        }
+      }
+
+      // mov byte [rbx + disp], imm8
+      void StoreByte(int32_t disp, uint8_t value) {
+        Emit({0xC6, 0x83});
+        Emit32(disp);
+        Emit({value});
+      }
+
+      // add byte [rbx + disp], imm8
+      void AddByte(int32_t disp, uint8_t value) {
+        Emit({0x80, 0x83});
+        Emit32(disp);
+        Emit({value});
+      }
+
+      // mov al, [rbx + disp]
+      void LoadAl(int32_t disp) {
+        Emit({0x8A, 0x83});
+        Emit32(disp);
+      }
+
+      // mov cl, [rbx + disp]
+      void LoadCl(int32_t disp) {
+        Emit({0x8A, 0x8B});
+        Emit32(disp);
+      }
+
+      // mov [rbx + disp], al
+      void StoreAl(int32_t disp) {
+        Emit({0x88, 0x83});
+        Emit32(disp);
+      }
+
+      // mov [rbx + disp], cl
+      void StoreCl(int32_t disp) {
+        Emit({0x88, 0x8B});
+        Emit32(disp);
+      }
+
+      // <op> [rbx + disp], al or <op> al, [rbx + disp] depending on the opcode
+      void AluAl(uint8_t opcode, int32_t disp) {
+        Emit({opcode, 0x83});
+        Emit32(disp);
+      }
+
+      // setcc cl
+      void SetCl(uint8_t condition) {
+        Emit({0x0F, condition, 0xC1});
+      }
+
+      // movzx r12d, word [rbx + disp]
+      void LoadI(int32_t disp) {
+        Emit({0x44, 0x0F, 0xB7, 0xA3});
+        Emit32(disp);
+      }
+
+      // mov [rbx + disp], r12w
+      void StoreI(int32_t disp) {
+        Emit({0x66, 0x44, 0x89, 0xA3});
+        Emit32(disp);
+      }
+
+      // mov word [rbx + disp], imm16
+      void StoreWord(int32_t disp, uint16_t value) {
+        Emit({0x66, 0xC7, 0x83});
+        Emit32(disp);
+        Emit16(value);
+      }
+
+      // mov <reg>, imm64
+      void LoadPointer(uint8_t reg, const void *pointer) {
+        Emit({0x48, static_cast<uint8_t>(0xB8 + reg)});
+        Emit64(reinterpret_cast<uint64_t>(pointer));
+      }
+
+      // jmp rel32, returns where the displacement goes
+      size_t Jump() {
+        Emit({0xE9});
+        Emit32(0);
+        return m_Code.size() - 4;
+      }
+
+      [[nodiscard]] size_t Size() const { return m_Code.size(); }
+
+      [[nodiscard]] const std::vector<uint8_t> &Code() const { return m_Code; }
+
+    private:
+      std::vector<uint8_t> m_Code;
+    };
+
+    constexpr uint8_t Rax = 0;
+    constexpr uint8_t Rsi = 6;
+
+    constexpr uint8_t OrMemAl = 0x08;
+    constexpr uint8_t AndMemAl = 0x20;
+    constexpr uint8_t XorMemAl = 0x30;
+    constexpr uint8_t AddAlMem = 0x02;
+    constexpr uint8_t SubAlMem = 0x2A;
+
+    constexpr uint8_t SetCarry = 0x92;
+    constexpr uint8_t SetNoCarry = 0x93;
+    constexpr uint8_t SetAbove = 0x97;
+
+    template<typename T>
+    int32_t OffsetOf(const Chip8::Registers &regs, const T &field) {
+      return static_cast<int32_t>(reinterpret_cast<const uint8_t *>(&field) -
+                                  reinterpret_cast<const uint8_t *>(&regs));
+    }
+  }
+
+  Recompiler::Recompiler() {
+    void *arena = mmap(nullptr, m_ArenaSize, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (arena == MAP_FAILED)
+      throw std::runtime_error("Unable to map memory for the recompiler");
+
+    m_Arena = static_cast<uint8_t *>(arena);
+  }
+
+  Recompiler::~Recompiler() {
+    munmap(m_Arena, m_ArenaSize);
+  }
+
+  void Recompiler::Reset() {
+    m_ArenaUsed = 0;
+  }
+
+  bool Recompiler::QuirksMatch(const bool *quirks) const {
+    return std::equal(quirks, quirks + 8, m_Quirks);
+  }
+
+  bool Recompiler::Compile(Chip8 &cpu, Chip8::Block &block) {
+    using Op = Chip8::Op;
+    using Quirk = Chip8::Quirk;
+
+    const auto &regs = cpu.regs;
+
+    const int32_t v = OffsetOf(regs, regs.v);
+    const int32_t vf = v + 0xF;
+    const int32_t pc = OffsetOf(regs, regs.pc);
+    const int32_t i = OffsetOf(regs, regs.i);
+    const int32_t dt = OffsetOf(regs, regs.dt);
+    const int32_t st = OffsetOf(regs, regs.st);
+
+    auto quirk = [&](Quirk quirk) {
+      return regs.quirks[static_cast<uint8_t>(quirk)];
+    };
+
+    Assembler a;
+    std::vector<size_t> exits;
+
+    // push rbx; push r12; push r13; mov r13, rdi; mov rbx, rsi
+    a.Emit({0x53, 0x41, 0x54, 0x41, 0x55, 0x49, 0x89, 0xFD, 0x48, 0x89, 0xF3});
+    a.LoadI(i);
+
+    for (size_t n = 0; n < block.ops.size(); n++) {
+      const auto &op = block.ops[n];
+      bool last = n + 1 == block.ops.size();
+
+      int32_t x = v + (op.operands[0].value & 0xF);
+      int32_t y = v + (op.operands[1].value & 0xF);
+      auto nn = static_cast<uint8_t>(op.operands[1].value);
+
+      switch (op.op) {
+        case Op::Unimplemented:
+          break;
+
+        case Op::LoadLiteral:
+          a.StoreByte(x, nn);
+          break;
+
+        case Op::AddLiteral:
+          a.AddByte(x, nn);
+          break;
+
+        case Op::LoadRegister:
+          a.LoadAl(y);
+          a.StoreAl(x);
+          break;
+
+        case Op::ORReg:
+        case Op::ANDReg:
+        case Op::XORReg:
+          a.LoadAl(y);
+          a.AluAl(op.op == Op::ORReg ? OrMemAl : op.op == Op::ANDReg ? AndMemAl : XorMemAl, x);
+
+          if (quirk(Quirk::Logic))
+            a.StoreByte(vf, 0);
+          break;
+
+        case Op::Add:
+          a.LoadAl(x);
+          a.AluAl(AddAlMem, y);
+          a.SetCl(SetCarry);
+          a.StoreAl(x);
+          a.StoreCl(vf);
+          break;
+
+        case Op::SubtractYFromX:
+          a.LoadAl(x);
+          a.AluAl(SubAlMem, y);
+          a.SetCl(SetNoCarry);
+          a.StoreAl(x);
+          a.StoreCl(vf);
+          break;
+
+        case Op::SubtractXFromY:
+          a.LoadAl(y);
+          a.AluAl(SubAlMem, x);
+          a.SetCl(SetNoCarry);
+          a.StoreAl(x);
+          a.StoreCl(vf);
+          break;
+
+        case Op::ShiftRight:
+          // The flag comes from vY even with the shift quirk, same as ProcShiftRight
+          a.LoadAl(quirk(Quirk::Shift) ? x : y);
+          a.Emit({0xD0, 0xE8});       // shr al, 1
+          a.LoadCl(y);
+          a.Emit({0x80, 0xE1, 0x01}); // and cl, 1
+          a.StoreAl(x);
+          a.StoreCl(vf);
+          break;
+
+        case Op::ShiftLeft:
+          a.LoadAl(quirk(Quirk::Shift) ? x : y);
+          a.Emit({0xD0, 0xE0});       // shl al, 1
+          a.LoadCl(y);
+          a.Emit({0xC0, 0xE9, 0x07}); // shr cl, 7
+          a.StoreAl(x);
+          a.StoreCl(vf);
+          break;
+
+        case Op::LoadILiteral:
+        case Op::LoadIExtended:
+          a.Emit({0x41, 0xBC});       // mov r12d, imm32
+          a.Emit32(op.operands[0].value);
+          break;
+
+        case Op::AddIWithReg:
+          a.Emit({0x0F, 0xB6, 0x83}); // movzx eax, byte [rbx + x]
+          a.Emit32(x);
+          a.Emit({0x41, 0x01, 0xC4}); // add r12d, eax
+
+          if (quirk(Quirk::IRegCarry)) {
+            a.Emit({0x41, 0x81, 0xFC}); // cmp r12d, 0xFFF
+            a.Emit32(0xFFF);
+            a.SetCl(SetAbove);
+            a.Emit({0x41, 0x81, 0xE4}); // and r12d, 0xFFF
+            a.Emit32(0xFFF);
+            a.StoreCl(vf);
+          } else {
+            a.Emit({0x41, 0x81, 0xE4}); // and r12d, 0xFFFF
+            a.Emit32(0xFFFF);
+          }
+          break;
+
+        case Op::LoadDelayToReg:
+          a.LoadAl(dt);
+          a.StoreAl(x);
+          break;
+
+        case Op::LoadRegToDelay:
+          a.LoadAl(x);
+          a.StoreAl(dt);
+          break;
+
+        case Op::LoadRegToBuzzer:
+          a.LoadAl(x);
+          a.StoreAl(st);
+          break;
+
+        case Op::Jump:
+          a.StoreWord(pc, op.operands[0].value);
+          continue;
+
+        default:
+          /* Everything else goes through its handler:
+           * mov [rbx + i], r12w; mov rdi, r13; mov rsi, &op; mov rax, &CallOut; call rax
+           */
+          a.StoreI(i);
+          a.Emit({0x4C, 0x89, 0xEF});
+          a.LoadPointer(Rsi, &op);
+          a.LoadPointer(Rax, reinterpret_cast<const void *>(&Recompiler::CallOut));
+          a.Emit({0xFF, 0xD0});
+          a.LoadI(i);
+
+          if (!last) {
+            // Bail out if the handler wrote over this block
+            a.LoadPointer(Rax, &block.valid);
+            a.Emit({0x80, 0x38, 0x00, 0x75, 0x0A}); // cmp byte [rax], 0; jne +10
+            a.Emit({0xB8});                         // mov eax, retired
+            a.Emit32(static_cast<uint32_t>(n + 1));
+            exits.push_back(a.Jump());
+          }
+          continue;
+      }
+
+      if (last)
+        a.StoreWord(pc, op.next);
+    }
+
+    a.Emit({0xB8});
+    a.Emit32(static_cast<uint32_t>(block.ops.size()));
+
+    size_t epilogue = a.Size();
+    for (auto exit: exits) {
+      a.Patch32(exit, static_cast<uint32_t>(epilogue - (exit + 4)));
+    }
+
+    // mov [rbx + i], r12w; pop r13; pop r12; pop rbx; ret
+    a.StoreI(i);
+    a.Emit({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});
+
+    const auto &code = a.Code();
+    size_t offset = (m_ArenaUsed + 15) & ~static_cast<size_t>(15);
+
+    if (offset + code.size() > m_ArenaSize)
+      return false;
+
+    if (m_ArenaUsed == 0)
+      std::copy_n(regs.quirks, 8, m_Quirks);
+
+    mprotect(m_Arena, m_ArenaSize, PROT_READ | PROT_WRITE);
+    memcpy(m_Arena + offset, code.data(), code.size());
+    mprotect(m_Arena, m_ArenaSize, PROT_READ | PROT_EXEC);
+
+    m_ArenaUsed = offset + code.size();
+    block.native = reinterpret_cast<Chip8::NativeBlock>(m_Arena + offset);
+
+    return true;
+  }
+
+  void Recompiler::CallOut(Chip8 *cpu, const Chip8::BlockOp *op) {
+    cpu->Enter(*op);
+    (cpu->*(cpu->m_Procs[static_cast<uint8_t>(op->op)]))();
+  }
+
+  uint32_t Recompiler::ExecuteChecked(Chip8 &cpu, Chip8::Block &block) {
+    if (ReachesOutside(block)) {
+      block.native = nullptr;
+      block.nativeRejected = true;
+
+      return cpu.ExecuteBlock(block);
+    }
+
+    auto before = Capture(cpu);
+
+    uint32_t nativeRetired = block.native(&cpu, &cpu.regs);
+    auto native = Capture(cpu);
+
+    Restore(cpu, before);
+
+    // The native run may have invalidated the block by writing over it, the interpreter will too
+    block.valid = true;
+    uint32_t retired = cpu.ExecuteBlock(block);
+
+    if (retired != nativeRetired || !(Capture(cpu) == native)) {
+      cpu.m_Machine.Warn(fmt::format("Recompiled block at 0x{:04X} disagrees with the interpreter, disabling it",
+                                     block.start));
+
+      block.native = nullptr;
+      block.nativeRejected = true;
+    }
+
+    return retired;
+  }
+
+  Recompiler::MachineState Recompiler::Capture(Chip8 &cpu) {
+    auto &machine = cpu.m_Machine;
+    auto &display = machine.GetDisplay();
+    auto &stack = machine.GetRam().GetStack();
+
+    MachineState state{};
+
+    std::copy_n(cpu.regs.v, 16, state.v);
+    state.pc = cpu.regs.pc;
+    state.i = cpu.regs.i;
+    state.st = cpu.regs.st;
+    state.dt = cpu.regs.dt;
+    state.pitch = cpu.regs.pitch;
+
+    state.halted = cpu.m_Halted;
+    state.waiting = cpu.m_Waiting;
+    state.highRes = cpu.m_HighRes;
+    state.pitchDirty = cpu.m_PitchDirty;
+    state.keyPressRegister = cpu.m_KeyPressRegister;
+    state.waitForInterrupt = cpu.m_WaitForInterrupt;
+
+    state.ram = machine.GetRam().GetMemory();
+    state.stack.assign(stack.begin(), stack.end());
+    state.faults = machine.GetRam().SaveFaults();
+    state.watchpointHits = machine.GetRam().GetWatchpoints().SaveHits();
+    state.planes = display.Buffers();
+    state.planeMask = display.PlaneMask();
+    state.displayHighRes = display.HighRes();
+    state.displayLoresGrid = display.LoresGrid();
+
+    state.mt = cpu.mt;
+    state.randomDraws = cpu.m_RandomDraws;
+
+    return state;
+  }
+
+  void Recompiler::Restore(Chip8 &cpu, const MachineState &state) {
+    auto &machine = cpu.m_Machine;
+    auto &display = machine.GetDisplay();
+    auto &stack = machine.GetRam().GetStack();
+
+    std::copy_n(state.v, 16, cpu.regs.v);
+    cpu.regs.pc = state.pc;
+    cpu.regs.i = state.i;
+    cpu.regs.st = state.st;
+    cpu.regs.dt = state.dt;
+    cpu.regs.pitch = state.pitch;
+
+    cpu.m_Halted = state.halted;
+    cpu.m_Waiting = state.waiting;
+    cpu.m_HighRes = state.highRes;
+    cpu.m_PitchDirty = state.pitchDirty;
+    cpu.m_KeyPressRegister = state.keyPressRegister;
+    cpu.m_WaitForInterrupt = state.waitForInterrupt;
+
+    // Copy in place, the CPU holds a pointer into RAM
+    std::copy(state.ram.begin(), state.ram.end(), machine.GetRam().GetMemory().begin());
+    stack.assign(state.stack.begin(), state.stack.end());
+    machine.GetRam().RestoreFaults(state.faults);
+    machine.GetRam().GetWatchpoints().RestoreHits(state.watchpointHits);
+    display.HighRes(state.displayHighRes);
+    display.Buffers(state.planes, state.displayLoresGrid);
+    display.PlaneMask(state.planeMask);
+
+    cpu.mt = state.mt;
+    cpu.m_RandomDraws = state.randomDraws;
+  }
+
+} // dorito
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Chip8.h"
+
+namespace dorito {
+
+  /* Compiles hot threaded-interpreter blocks to x86-64 code (Linux only,
+   * see DORITO_JIT). Register and timer ops run inline, with I held in a
+   * host register for the length of the block. Everything else calls
+   * back into the same Proc* handler the interpreter would have used.
+   */
+  class Recompiler {
+  public:
+    Recompiler();
+
+    ~Recompiler();
+
+    // Emits native code for the block, returns false when out of space
+    bool Compile(Chip8 &cpu, Chip8::Block &block);
+
+    // Drops all generated code, blocks must forget their native entry first
+    void Reset();
+
+    /* Runs the block natively and through the interpreter and compares the
+     * results. Blocks that save or load flags reach outside the machine,
+     * which can't be undone, so those are handed to the interpreter alone.
+     */
+    uint32_t ExecuteChecked(Chip8 &cpu, Chip8::Block &block);
+
+    [[nodiscard]] bool QuirksMatch(const bool *quirks) const;
+
+  private:
+    struct MachineState {
+      uint8_t v[16];
+      uint16_t pc;
+      uint16_t i;
+      uint8_t st;
+      uint8_t dt;
+      double pitch;
+
+      bool halted;
+      bool waiting;
+      bool highRes;
+      bool pitchDirty;
+      uint8_t keyPressRegister;
+      uint8_t waitForInterrupt;
+
+      std::vector<uint8_t> ram;
+      std::vector<uint16_t> stack;
+      Memory::Faults faults;
+      Watchpoints::Hits watchpointHits;
+      Display::Planes planes;
+      uint8_t planeMask;
+      bool displayHighRes;
+      bool displayLoresGrid;
+
+      std::mt19937 mt;
+      uint64_t randomDraws;
+
+      bool operator==(const MachineState &other) const = default;
+    };
+
+    static MachineState Capture(Chip8 &cpu);
+
+    static void Restore(Chip8 &cpu, const MachineState &state);
+
+    static void CallOut(Chip8 *cpu, const Chip8::BlockOp *op);
+
+  private:
+    static constexpr size_t m_ArenaSize = 4 * 1024 * 1024;
+
+    uint8_t *m_Arena = nullptr;
+    size_t m_ArenaUsed = 0;
+
+    // Quirks are baked into the generated code
+    bool m_Quirks[8]{};
+  };
+
+} // dorito
@@ -0,0 +1,176 @@
+#include "Tracer.h"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <iterator>
+
+#include <fmt/format.h>
+
+namespace dorito {
+  namespace {
+    constexpr char Magic[4] = {'D', 'T', 'R', 'C'};
+    constexpr uint16_t Version = 1;
+
+    void Put16(std::vector<uint8_t> &out, uint16_t value) {
+      out.push_back(value & 0xFF);
+      out.push_back(value >> 8);
+    }
+
+    // LEB128, the gap between two traced cycles is nearly always 1
+    void PutVarint(std::vector<uint8_t> &out, uint64_t value) {
+      do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out.push_back(byte | (value ? 0x80 : 0));
+      } while (value);
+    }
+
+    struct Reader {
+      const std::vector<uint8_t> &data;
+      size_t pos = 0;
+
+      [[nodiscard]] bool Has(size_t count) const {
+        return pos + count <= data.size();
+      }
+
+      uint16_t Get16() {
+        uint16_t value = data[pos] | (data[pos + 1] << 8);
+        pos += 2;
+        return value;
+      }
+
+      bool GetVarint(uint64_t &value) {
+        value = 0;
+
+        for (uint8_t shift = 0; shift < 64; shift += 7) {
+          if (!Has(1))
+            return false;
+
+          uint8_t byte = data[pos++];
+          value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+          if (!(byte & 0x80))
+            return true;
+        }
+
+        return false;
+      }
+    };
+  }
+
+  void Tracer::Enable(bool isEnabled, uint32_t capacity) {
+    m_Enabled = isEnabled;
+    m_Head = 0;
+
+    if (!isEnabled)
+      return;
+
+    capacity = std::bit_ceil(capacity < 2 ? 2u : capacity);
+
+    if (m_Entries.size() != capacity) {
+      m_Entries.assign(capacity, TraceEntry{});
+      m_Mask = capacity - 1;
+    }
+  }
+
+  std::string Tracer::Save(const std::string &path) const {
+    auto count = Size();
+
+    std::vector<uint8_t> out;
+    out.reserve(20 + static_cast<size_t>(count) * 12);
+
+    out.insert(out.end(), std::begin(Magic), std::end(Magic));
+    Put16(out, Version);
+    Put16(out, 0);
+
+    for (uint8_t n = 0; n < 4; n++) {
+      out.push_back((count >> (n * 8)) & 0xFF);
+    }
+
+    uint64_t cycle = 0;
+
+    for (uint32_t index = 0; index < count; index++) {
+      const auto &entry = At(index);
+
+      PutVarint(out, entry.cycle - cycle);
+      cycle = entry.cycle;
+
+      Put16(out, entry.pc);
+      Put16(out, entry.opcode);
+      Put16(out, entry.i);
+      Put16(out, entry.changed);
+
+      // The first record carries every register so the rest can be rebuilt from it
+      for (uint8_t n = 0; n < 16; n++) {
+        if (index == 0 || (entry.changed >> n) & 1)
+          out.push_back(entry.v[n]);
+      }
+    }
+
+    std::ofstream stream(path, std::ios::binary);
+
+    if (!stream.good())
+      return fmt::format("Couldn't open {} for writing", path);
+
+    stream.write(reinterpret_cast<const char *>(out.data()), static_cast<std::streamsize>(out.size()));
+
+    return stream.good() ? std::string{} : fmt::format("Couldn't write {}", path);
+  }
+
+  std::string Tracer::Load(const std::string &path, std::vector<TraceEntry> &entries) {
+    std::ifstream stream(path, std::ios::binary);
+
+    if (!stream.good())
+      return fmt::format("Couldn't open {}", path);
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    Reader reader{data};
+
+    if (!reader.Has(12) || !std::equal(std::begin(Magic), std::end(Magic), data.begin()))
+      return fmt::format("{} isn't a trace", path);
+
+    reader.pos = 4;
+
+    if (reader.Get16() != Version)
+      return fmt::format("{} is from an unknown trace version", path);
+
+    reader.pos += 2;
+
+    uint32_t count = data[8] | (data[9] << 8) | (data[10] << 16) | (static_cast<uint32_t>(data[11]) << 24);
+    reader.pos = 12;
+
+    entries.clear();
+    // Every record is at least 9 bytes, don't trust a bogus count
+    entries.reserve(std::min<size_t>(count, data.size() / 9));
+
+    TraceEntry entry{};
+
+    for (uint32_t index = 0; index < count; index++) {
+      uint64_t delta = 0;
+
+      if (!reader.GetVarint(delta) || !reader.Has(8))
+        return fmt::format("{} is cut short", path);
+
+      entry.cycle += delta;
+      entry.pc = reader.Get16();
+      entry.opcode = reader.Get16();
+      entry.i = reader.Get16();
+      entry.changed = reader.Get16();
+
+      for (uint8_t n = 0; n < 16; n++) {
+        if (index == 0 || (entry.changed >> n) & 1) {
+          if (!reader.Has(1))
+            return fmt::format("{} is cut short", path);
+
+          entry.v[n] = data[reader.pos++];
+        }
+      }
+
+      entries.push_back(entry);
+    }
+
+    return {};
+  }
+
+} // dorito
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace dorito {
+
+  // One executed instruction, 32 bytes so a million of them fit in 32MB
+  struct TraceEntry {
+    uint64_t cycle;
+    uint16_t pc;
+    uint16_t opcode;
+
+    // I after the instruction ran
+    uint16_t i;
+
+    // Bit n set when vn changed
+    uint16_t changed;
+
+    // Registers after the instruction ran
+    uint8_t v[16];
+  };
+
+  /* The last N instructions the CPU stepped through, kept in a ring that
+   * is allocated once when tracing starts. Recording is a couple of
+   * stores and a 16 byte compare, anything readable is left to whoever
+   * looks at the trace afterwards.
+   */
+  class Tracer {
+  public:
+    static constexpr uint32_t DefaultCapacity = 1 << 18;
+
+  public:
+    [[nodiscard]] bool Enabled() const { return m_Enabled; }
+
+    // Rounds capacity up to a power of two and starts from an empty trace
+    void Enable(bool isEnabled, uint32_t capacity = DefaultCapacity);
+
+    void Clear() {
+      m_Head = 0;
+    }
+
+    // Slot for the instruction about to run, filled in with the state before it
+    TraceEntry &Begin(uint64_t cycle, uint16_t pc, uint16_t opcode, const uint8_t *v) {
+      auto &entry = m_Entries[m_Head++ & m_Mask];
+
+      entry.cycle = cycle;
+      entry.pc = pc;
+      entry.opcode = opcode;
+      memcpy(entry.v, v, 16);
+
+      return entry;
+    }
+
+    static void End(TraceEntry &entry, uint16_t i, const uint8_t *v) {
+      uint16_t changed = 0;
+
+      for (uint8_t n = 0; n < 16; n++) {
+        changed |= static_cast<uint16_t>(entry.v[n] != v[n]) << n;
+      }
+
+      entry.i = i;
+      entry.changed = changed;
+      memcpy(entry.v, v, 16);
+    }
+
+    [[nodiscard]] uint32_t Size() const {
+      return m_Head < m_Entries.size() ? static_cast<uint32_t>(m_Head) : static_cast<uint32_t>(m_Entries.size());
+    }
+
+    [[nodiscard]] uint32_t Capacity() const { return static_cast<uint32_t>(m_Entries.size()); }
+
+    // Total recorded since the last clear, including what has been overwritten
+    [[nodiscard]] uint64_t Recorded() const { return m_Head; }
+
+    // Oldest first, index < Size()
+    [[nodiscard]] const TraceEntry &At(uint32_t index) const {
+      return m_Entries[(m_Head - Size() + index) & m_Mask];
+    }
+
+    /* Binary dump, a header followed by one record per entry holding only
+     * the registers that changed. Returns an empty string on success.
+     */
+    [[nodiscard]] std::string Save(const std::string &path) const;
+
+    static std::string Load(const std::string &path, std::vector<TraceEntry> &entries);
+
+  private:
+    std::vector<TraceEntry> m_Entries;
+    uint64_t m_Head = 0;
+    uint64_t m_Mask = 0;
+
+    bool m_Enabled = false;
+  };
+
+} // dorito
@@ -0,0 +1,118 @@
+#include "Watchpoints.h"
+
+#include <fmt/format.h>
+
+namespace dorito {
+  template<uint8_t Access>
+  void Watchpoints::Check(Watchpoint::Space space, uint16_t addr, uint8_t before, uint8_t after) {
+    for (auto &watchpoint: m_List) {
+      if (!watchpoint.enabled || watchpoint.space != space)
+        continue;
+
+      if (static_cast<uint32_t>(addr - watchpoint.addr) >= watchpoint.length)
+        continue;
+
+      bool hit = (watchpoint.access & Access) ||
+                 (Access == Watchpoint::Write && (watchpoint.access & Watchpoint::Change) && before != after);
+
+      if (!hit)
+        continue;
+
+      watchpoint.hits++;
+      m_Triggered = true;
+
+      auto where = space == Watchpoint::Space::Audio
+                   ? fmt::format("audio pattern byte {}", addr)
+                   : fmt::format("0x{:04X}", addr);
+
+      m_LastHit = Access == Watchpoint::Read
+                  ? fmt::format("Watchpoint '{}': read 0x{:02X} from {}", watchpoint.label, before, where)
+                  : fmt::format("Watchpoint '{}': wrote 0x{:02X} over 0x{:02X} at {}",
+                                watchpoint.label, after, before, where);
+    }
+  }
+
+  template void Watchpoints::Check<Watchpoint::Read>(Watchpoint::Space, uint16_t, uint8_t, uint8_t);
+
+  template void Watchpoints::Check<Watchpoint::Write>(Watchpoint::Space, uint16_t, uint8_t, uint8_t);
+
+  void Watchpoints::Add(const Watchpoint &watchpoint) {
+    m_List.push_back(watchpoint);
+    Rearm();
+  }
+
+  void Watchpoints::Toggle(const std::string &label) {
+    for (auto &watchpoint: m_List) {
+      if (watchpoint.label == label) {
+        watchpoint.enabled = !watchpoint.enabled;
+        break;
+      }
+    }
+
+    Rearm();
+  }
+
+  void Watchpoints::Remove(const std::string &label) {
+    std::erase_if(m_List, [&](const Watchpoint &watchpoint) {
+      return watchpoint.label == label;
+    });
+
+    Rearm();
+  }
+
+  Watchpoints::Hits Watchpoints::SaveHits() const {
+    Hits hits;
+
+    for (const auto &watchpoint: m_List) {
+      hits.counts.push_back(watchpoint.hits);
+    }
+
+    hits.triggered = m_Triggered;
+    hits.lastHit = m_LastHit;
+
+    return hits;
+  }
+
+  void Watchpoints::RestoreHits(const Hits &hits) {
+    for (size_t n = 0; n < m_List.size() && n < hits.counts.size(); n++) {
+      m_List[n].hits = hits.counts[n];
+    }
+
+    m_Triggered = hits.triggered;
+    m_LastHit = hits.lastHit;
+  }
+
+  void Watchpoints::Clear() {
+    m_List.clear();
+    Rearm();
+  }
+
+  void Watchpoints::Rearm() {
+    m_Pages.fill(0);
+    m_AudioFlags = 0;
+    m_Armed = false;
+
+    for (const auto &watchpoint: m_List) {
+      if (!watchpoint.enabled || watchpoint.length == 0)
+        continue;
+
+      // Spotting a change means looking at every write
+      uint8_t flags = watchpoint.access & Watchpoint::Read;
+      if (watchpoint.access & (Watchpoint::Write | Watchpoint::Change))
+        flags |= Watchpoint::Write;
+
+      if (watchpoint.space == Watchpoint::Space::Audio) {
+        m_AudioFlags |= flags;
+      } else {
+        uint32_t last = watchpoint.addr + watchpoint.length - 1u;
+
+        for (uint32_t page = watchpoint.addr >> 8; page <= (last >> 8) && page < m_Pages.size(); page++) {
+          m_Pages[page] |= flags;
+        }
+      }
+
+      m_Armed = m_Armed || flags != 0;
+    }
+  }
+
+} // dorito
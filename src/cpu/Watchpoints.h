@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dorito {
+
+  struct Watchpoint {
+    // What to stop on, combined as a mask
+    static constexpr uint8_t Read = 1;
+    static constexpr uint8_t Write = 2;
+    static constexpr uint8_t Change = 4;
+
+    enum class Space : uint8_t {
+      Ram,
+      Audio
+    };
+
+    std::string label;
+    Space space;
+    uint16_t addr;
+    uint16_t length;
+    uint8_t access;
+    bool enabled;
+
+    uint32_t hits = 0;
+  };
+
+  /* Data watchpoints over RAM and the audio pattern buffer. Memory asks
+   * PageFlags on every access, only the pages flagged here cost more
+   * than that one load.
+   */
+  class Watchpoints {
+  public:
+    [[nodiscard]] uint8_t PageFlags(uint16_t addr) const {
+      return m_Pages[addr >> 8];
+    }
+
+    [[nodiscard]] uint8_t AudioFlags() const { return m_AudioFlags; }
+
+    [[nodiscard]] bool AnyArmed() const { return m_Armed; }
+
+    // Slow path for a flagged access, records any hit
+    template<uint8_t Access>
+    void Check(Watchpoint::Space space, uint16_t addr, uint8_t before, uint8_t after);
+
+    // Set once a watchpoint fires, whoever stops for it clears it
+    [[nodiscard]] bool Triggered() const { return m_Triggered; }
+
+    void ClearTriggered() { m_Triggered = false; }
+
+    // What the last hit was, for showing to the user
+    [[nodiscard]] const std::string &LastHit() const { return m_LastHit; }
+
+    // Hit counts and the triggered flag, for undoing a run that is about to be replayed
+    struct Hits {
+      std::vector<uint32_t> counts;
+      bool triggered = false;
+      std::string lastHit;
+
+      bool operator==(const Hits &other) const = default;
+    };
+
+    [[nodiscard]] Hits SaveHits() const;
+
+    void RestoreHits(const Hits &hits);
+
+    void Add(const Watchpoint &watchpoint);
+
+    void Toggle(const std::string &label);
+
+    void Remove(const std::string &label);
+
+    void Clear();
+
+    [[nodiscard]] const std::vector<Watchpoint> &List() const { return m_List; }
+
+  private:
+    void Rearm();
+
+  private:
+    std::vector<Watchpoint> m_List;
+
+    // Access mask any enabled watchpoint wants for each 256 byte page
+    std::array<uint8_t, 0x100> m_Pages{};
+    uint8_t m_AudioFlags = 0;
+    bool m_Armed = false;
+
+    bool m_Triggered = false;
+    std::string m_LastHit;
+  };
+
+} // dorito
@@ -1,40 +1,31 @@
 #include "Display.h"
 
-#include <iostream>
+#include <algorithm>
 
 namespace dorito {
   Display::Display() {
-    EventManager::Get().Attach<
-        Events::SetColor,
-        &Display::HandleSetColor
-    >(this);
-
-    EventManager::Get().Attach<
-        Events::SetPalette,
-        &Display::HandleSetPalette
-    >(this);
-
     Reset();
   }
 
-  Display::~Display() {
-    EventManager::Get().DetachAll(this);
-  }
-
   void Display::Reset() {
     m_PlaneMask = 0x1;
     m_HighRes = false;
-    memset(&m_Buffer[0][0], 0, 128 * 64);
-    memset(&m_Buffer[1][0], 0, 128 * 64);
-  }
+    m_LoresGrid = true;
 
-  bool Display::Plot(uint8_t plane, uint8_t x, uint8_t y) {
-    if (!m_HighRes) {
-      x *= 2;
-      y *= 2;
+    for (auto &plane: m_Planes) {
+      plane.fill(0);
     }
+  }
+
+  void Display::HighRes(bool isHighRes) {
+    m_HighRes = isHighRes;
 
-    return SetPixel(plane, x, y);
+    if (isHighRes) {
+      if (m_LoresGrid)
+        Expand();
+    } else if (!m_LoresGrid && Empty()) {
+      m_LoresGrid = true;
+    }
   }
 
   void Display::Clear() {
@@ -42,140 +33,261 @@ namespace dorito {
       if ((m_PlaneMask & (layer + 1)) == 0)
         continue;
 
-      memset(&m_Buffer[layer][0], 0, 128 * 64);
+      m_Planes[layer].fill(0);
     }
+
+    // Lores that was left on the hires grid can go back to its own once nothing is showing
+    if (!m_HighRes && !m_LoresGrid && Empty())
+      m_LoresGrid = true;
   }
 
-  void Display::CopyRow(uint8_t source, uint8_t destination) {
-    for (auto i = 0; i < 2; i++) {
+  bool Display::DrawSprite(uint8_t plane, uint8_t x, uint8_t y, const uint32_t *patterns, uint8_t rows, uint8_t width, bool clip) {
+    auto height = Height();
 
-      if ((m_PlaneMask & (i + 1)) == 0)
-        continue;
+    rows = std::min(rows, MaxSpriteRows);
 
-      std::copy_n(m_Buffer[i].cbegin() + source * 128,
-                  128,
-                  m_Buffer[i].begin() + destination * 128);
-    }
-  }
+    if (clip)
+      rows = std::min<uint8_t>(rows, height - y);
 
-  void Display::CopyColumn(uint8_t source, uint8_t destination) {
-    for (auto i = 0; i < 2; i++) {
+    // Lores on the hires grid has every pixel as a 2x2 block
+    uint8_t scale = m_HighRes || m_LoresGrid ? 1 : 2;
+    uint8_t columns = Width() * scale;
 
-      if ((m_PlaneMask & (i + 1)) == 0)
-        continue;
+    uint64_t hi[MaxSpriteRows];
+    uint64_t lo[MaxSpriteRows];
+    uint8_t at[MaxSpriteRows];
 
-      for (int y = 0; y < 64; ++y) {
-        auto rowOffset = y * 128;
-        m_Buffer[i][destination + rowOffset] = m_Buffer[i][source + rowOffset];
-      }
+    // Every row lines up with the same shift, do them all before touching the plane
+    for (uint8_t n = 0; n < rows; n++) {
+      uint8_t row = y + n;
+      at[n] = (row >= height ? row - height : row) * scale;
+
+      auto pattern = scale == 1 ? patterns[n] : Double(patterns[n]);
+      Place(pattern, width * scale, x * scale, columns, clip, hi[n], lo[n]);
     }
-  }
 
-  void Display::ClearRow(uint8_t row) {
-    for (auto i = 0; i < 2; i++) {
+    auto &words = m_Planes[plane];
+    uint64_t hits = 0;
 
-      if ((m_PlaneMask & (i + 1)) == 0)
-        continue;
+    if (scale == 1) {
+      for (uint8_t n = 0; n < rows; n++) {
+        auto *row = &words[at[n] * 2];
+
+        hits |= (row[0] & hi[n]) | (row[1] & lo[n]);
+
+        row[0] ^= hi[n];
+        row[1] ^= lo[n];
+      }
 
-      std::fill_n(m_Buffer[i].begin() + row * 128, 128, 0);
+      return hits != 0;
     }
-  }
 
-  void Display::ClearColumn(uint8_t column) {
-    for (auto i = 0; i < 2; i++) {
+    // The top left pixel of a block decides what the whole block becomes
+    for (uint8_t n = 0; n < rows; n++) {
+      auto *top = &words[at[n] * 2];
+      auto *bottom = top + 2;
 
-      if ((m_PlaneMask & (i + 1)) == 0)
-        continue;
+      uint64_t leftHi = hi[n] & LeftColumns;
+      uint64_t leftLo = lo[n] & LeftColumns;
 
-      for (int y = 0; y < 64; ++y) {
-        m_Buffer[i][column + (y * 128)] = 0;
-      }
+      hits |= (top[0] & leftHi) | (top[1] & leftLo);
+
+      uint64_t litHi = ~top[0] & leftHi;
+      uint64_t litLo = ~top[1] & leftLo;
+      litHi |= litHi >> 1;
+      litLo |= litLo >> 1;
+
+      top[0] = (top[0] & ~hi[n]) | litHi;
+      top[1] = (top[1] & ~lo[n]) | litLo;
+      bottom[0] = (bottom[0] & ~hi[n]) | litHi;
+      bottom[1] = (bottom[1] & ~lo[n]) | litLo;
     }
+
+    return hits != 0;
   }
 
+  /* Scroll counts are in hires pixels in both modes, so lores moves by
+   * half of them. An odd count is the old SCHIP half pixel scroll and
+   * needs the hires grid to show it.
+   */
   void Display::ScrollDown(uint8_t count) {
-    for (int y = 64 - count - 1; y >= 0; --y) {
-      CopyRow(y, y + count);
-    }
+    if (m_LoresGrid && (count & 1))
+      Expand();
+
+    uint8_t rows = m_LoresGrid ? Rows / 2 : Rows;
+
+    if (m_LoresGrid)
+      count /= 2;
+
+    count = std::min(count, rows);
 
-    for (int y = 0; y < count; ++y) {
-      ClearRow(y);
+    for (auto layer = 0; layer < 2; layer++) {
+      if ((m_PlaneMask & (layer + 1)) == 0)
+        continue;
+
+      // Rows are contiguous words, moving them is one memmove
+      auto begin = m_Planes[layer].begin();
+      auto end = begin + rows * 2;
+
+      std::copy_backward(begin, end - count * 2, end);
+      std::fill_n(begin, count * 2, 0);
     }
   }
 
   void Display::ScrollUp(uint8_t count) {
-    for (int y = 0; y < (64 - count); ++y) {
-      CopyRow(y + count, y);
-    }
+    if (m_LoresGrid && (count & 1))
+      Expand();
+
+    uint8_t rows = m_LoresGrid ? Rows / 2 : Rows;
+
+    if (m_LoresGrid)
+      count /= 2;
+
+    count = std::min(count, rows);
+
+    for (auto layer = 0; layer < 2; layer++) {
+      if ((m_PlaneMask & (layer + 1)) == 0)
+        continue;
 
-    for (int y = 0; y < count; ++y) {
-      ClearRow(64 - y - 1);
+      auto begin = m_Planes[layer].begin();
+      auto end = begin + rows * 2;
+
+      std::copy(begin + count * 2, end, begin);
+      std::fill(end - count * 2, end, 0);
     }
   }
 
   void Display::ScrollLeft(uint8_t count) {
-    for (int x = 0; x < (128 - count); ++x) {
-      CopyColumn(x + count, x);
-    }
+    if (m_LoresGrid && (count & 1))
+      Expand();
+
+    if (m_LoresGrid)
+      count /= 2;
+
+    if (count == 0)
+      return;
+
+    uint8_t rows = m_LoresGrid ? Rows / 2 : Rows;
+
+    for (auto layer = 0; layer < 2; layer++) {
+      if ((m_PlaneMask & (layer + 1)) == 0)
+        continue;
 
-    for (int x = 0; x < count; ++x) {
-      ClearColumn(128 - x - 1);
+      ShiftLeft(m_Planes[layer], rows, count);
     }
   }
 
   void Display::ScrollRight(uint8_t count) {
-    for (int x = 128 - count - 1; x >= 0; --x) {
-      CopyColumn(x, x + count);
-    }
+    if (m_LoresGrid && (count & 1))
+      Expand();
+
+    if (m_LoresGrid)
+      count /= 2;
+
+    if (count == 0)
+      return;
+
+    uint8_t rows = m_LoresGrid ? Rows / 2 : Rows;
+
+    for (auto layer = 0; layer < 2; layer++) {
+      if ((m_PlaneMask & (layer + 1)) == 0)
+        continue;
 
-    for (int x = 0; x < count; ++x) {
-      ClearColumn(x);
+      auto &plane = m_Planes[layer];
+
+      ShiftRight(plane, rows, count);
+
+      // A lores row ends with its first word, what went past it is off screen
+      if (m_LoresGrid) {
+        for (uint8_t y = 0; y < rows; y++) {
+          plane[y * 2 + 1] = 0;
+        }
+      }
     }
   }
 
-  bool Display::SetPixel(uint8_t plane, uint8_t x, uint8_t y) {
-    bool result = false;
-
-    x %= 128;
-    y %= 64;
+  void Display::ShiftLeft(Plane &plane, uint8_t rows, uint8_t count) {
+    // Whole words first, then what's left is the same bit shift on every row
+    if (count >= 64) {
+      for (uint8_t y = 0; y < rows; y++) {
+        plane[y * 2] = plane[y * 2 + 1];
+        plane[y * 2 + 1] = 0;
+      }
 
-    uint16_t indexTL = (y * 128) + x;
-    uint16_t indexTR = (y * 128) + x + 1;
-    uint16_t indexBL = ((y + 1) * 128) + x;
-    uint16_t indexBR = ((y + 1) * 128) + x + 1;
+      count -= 64;
+    }
 
-    if (y + 1 >= 64) {
-      indexBR = indexTL;
-      indexBL = indexTL;
+    if (count >= 64) {
+      std::fill_n(plane.begin(), rows * 2, 0);
+      return;
     }
 
-    if (x + 1 >= 128) {
-      indexTR = indexTL;
-      indexBR = indexTL;
+    if (count == 0)
+      return;
+
+    for (uint8_t y = 0; y < rows; y++) {
+      auto hi = plane[y * 2];
+      auto lo = plane[y * 2 + 1];
+
+      plane[y * 2] = (hi << count) | (lo >> (64 - count));
+      plane[y * 2 + 1] = lo << count;
     }
+  }
+
+  void Display::ShiftRight(Plane &plane, uint8_t rows, uint8_t count) {
+    if (count >= 64) {
+      for (uint8_t y = 0; y < rows; y++) {
+        plane[y * 2 + 1] = plane[y * 2];
+        plane[y * 2] = 0;
+      }
 
-    if (m_Buffer[plane][indexTL]) {
-      m_Buffer[plane][indexTL] = 0;
-      result = true;
-    } else {
-      m_Buffer[plane][indexTL] = 1;
+      count -= 64;
     }
 
-    if (!m_HighRes) {
-      m_Buffer[plane][indexTR] = m_Buffer[plane][indexTL];
-      m_Buffer[plane][indexBL] = m_Buffer[plane][indexTL];
-      m_Buffer[plane][indexBR] = m_Buffer[plane][indexTL];
+    if (count >= 64) {
+      std::fill_n(plane.begin(), rows * 2, 0);
+      return;
     }
 
-    return result;
+    if (count == 0)
+      return;
+
+    for (uint8_t y = 0; y < rows; y++) {
+      auto hi = plane[y * 2];
+      auto lo = plane[y * 2 + 1];
+
+      plane[y * 2] = hi >> count;
+      plane[y * 2 + 1] = (lo >> count) | (hi << (64 - count));
+    }
   }
 
-  void Display::HandleSetColor(const Events::SetColor &event) {
-    m_Palette[event.index] = event.color;
+  void Display::Expand() {
+    for (auto &plane: m_Planes) {
+      // Bottom up, every lores row lands at or below where it was read from
+      for (auto y = Rows / 2; y-- > 0;) {
+        auto pixels = plane[y * 2];
+        auto hi = Double(static_cast<uint32_t>(pixels >> 32));
+        auto lo = Double(static_cast<uint32_t>(pixels));
+
+        plane[y * 4] = hi;
+        plane[y * 4 + 1] = lo;
+        plane[y * 4 + 2] = hi;
+        plane[y * 4 + 3] = lo;
+      }
+    }
+
+    m_LoresGrid = false;
   }
 
-  void Display::HandleSetPalette(const Events::SetPalette &event) {
-    m_Palette = event.palette;
+  bool Display::Empty() const {
+    for (const auto &plane: m_Planes) {
+      for (auto word: plane) {
+        if (word != 0)
+          return false;
+      }
+    }
+
+    return true;
   }
 
-} // dorito
\ No newline at end of file
+} // dorito
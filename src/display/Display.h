@@ -1,34 +1,52 @@
 #pragma once
 
-#include <raylib.h>
+#include <array>
 #include <cstdint>
-#include <vector>
-
-#include "core/events/EventManager.h"
 
 namespace dorito {
 
   class Display {
   public:
-    Display();
+    static constexpr uint8_t Columns = 128;
+    static constexpr uint8_t Rows = 64;
+    static constexpr uint8_t MaxSpriteRows = 16;
+
+    /* One bit per pixel, two words per row with the leftmost pixel in the
+     * top bit of the first. Lores keeps its 64x32 pixels in the first word
+     * of the top 32 rows, unless a half pixel scroll has put it on the
+     * hires grid as 2x2 blocks.
+     */
+    using Plane = std::array<uint64_t, Rows * 2>;
+    using Planes = std::array<Plane, 2>;
 
-    ~Display();
+  public:
+    Display();
 
     void Reset();
 
-    void HighRes(bool isHighRes) {
-      m_HighRes = isHighRes;
-    }
+    // Whatever is on screen stays, scaled to the new grid when it has to be
+    void HighRes(bool isHighRes);
 
     void PlaneMask(uint8_t mask) {
       m_PlaneMask = mask & 0x3;
     }
 
-    uint8_t PlaneMask() { return m_PlaneMask; }
+    uint8_t PlaneMask() const { return m_PlaneMask; }
+
+    void Buffers(const Planes &planes, bool loresGrid) {
+      m_Planes = planes;
+      m_LoresGrid = loresGrid && !m_HighRes;
+    }
 
     void Clear();
 
-    bool Plot(uint8_t plane, uint8_t x, uint8_t y);
+    /* XORs a sprite onto the plane at x, y in the current resolution, one
+     * pattern per row holding its width low bits from the leftmost pixel
+     * down. What runs off the right or bottom edge is dropped when
+     * clipping and comes back in on the other side otherwise. True when
+     * any lit pixel was turned off.
+     */
+    bool DrawSprite(uint8_t plane, uint8_t x, uint8_t y, const uint32_t *patterns, uint8_t rows, uint8_t width, bool clip);
 
     void ScrollDown(uint8_t count);
 
@@ -51,47 +69,76 @@ namespace dorito {
       return m_HighRes ? 128 : 64;
     }
 
-    [[nodiscard]] const std::vector<Color> &Palette() const {
-      return m_Palette;
+    [[nodiscard]] const Planes &Buffers() const {
+      return m_Planes;
     }
 
-    [[nodiscard]] const std::vector<std::vector<uint8_t>> &Buffers() const {
-      return m_Buffer;
+    // True while the planes hold lores pixels at 64x32 rather than on the hires grid
+    [[nodiscard]] bool LoresGrid() const {
+      return m_LoresGrid;
+    }
+
+    // x and y in whichever grid the plane is stored at
+    [[nodiscard]] static bool Pixel(const Plane &plane, uint8_t x, uint8_t y) {
+      return (plane[y * 2 + (x >> 6)] >> (63 - (x & 63))) & 1;
+    }
+
+    // x and y on the 128x64 screen, scaling up a lores grid
+    [[nodiscard]] static bool ScreenPixel(const Plane &plane, bool loresGrid, uint8_t x, uint8_t y) {
+      return loresGrid ? Pixel(plane, x / 2, y / 2) : Pixel(plane, x, y);
     }
 
   private:
-    bool SetPixel(uint8_t plane, uint8_t x, uint8_t y);
+    // Even columns, the left pixel of every lores block
+    static constexpr uint64_t LeftColumns = 0xAAAAAAAAAAAAAAAA;
+
+    // Lines pattern up at column x of a row columns wide, split over hi and lo
+    static void Place(uint64_t pattern, uint8_t width, uint8_t x, uint8_t columns, bool clip, uint64_t &hi, uint64_t &lo) {
+      uint64_t left = pattern << (64 - width);
+
+      if (x < 64) {
+        hi = left >> x;
+        lo = x == 0 || columns == 64 ? 0 : left << (64 - x);
+      } else {
+        hi = 0;
+        lo = left >> (x - 64);
+      }
+
+      if (!clip && x + width > columns) {
+        // Only the overflowing low bits survive the shift, and land on the left edge
+        hi |= pattern << (64 - (x + width - columns));
+      }
+    }
 
-    void CopyRow(uint8_t source, uint8_t destination);
+    // The first rows of the plane count pixels over, filling in with unlit ones
+    static void ShiftLeft(Plane &plane, uint8_t rows, uint8_t count);
 
-    void CopyColumn(uint8_t source, uint8_t destination);
+    static void ShiftRight(Plane &plane, uint8_t rows, uint8_t count);
 
-    void ClearRow(uint8_t row);
+    // Every bit twice, for lores pixels on the hires grid
+    static uint64_t Double(uint32_t pattern) {
+      uint64_t bits = pattern;
+      bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFF;
+      bits = (bits | (bits << 8)) & 0x00FF00FF00FF00FF;
+      bits = (bits | (bits << 4)) & 0x0F0F0F0F0F0F0F0F;
+      bits = (bits | (bits << 2)) & 0x3333333333333333;
+      bits = (bits | (bits << 1)) & 0x5555555555555555;
 
-    void ClearColumn(uint8_t column);
+      return bits | (bits << 1);
+    }
 
-  private:
-    void HandleSetColor(const Events::SetColor &event);
+    // Moves a lores grid onto the hires grid as 2x2 blocks
+    void Expand();
 
-    void HandleSetPalette(const Events::SetPalette &event);
+    [[nodiscard]] bool Empty() const;
 
   private:
     uint8_t m_PlaneMask = 0x1;
 
     bool m_HighRes = false;
+    bool m_LoresGrid = true;
 
-    std::vector<std::vector<uint8_t>> m_Buffer = {
-        std::vector<uint8_t>(128 * 64),
-        std::vector<uint8_t>(128 * 64)
-    };
-
-    std::vector<Color> m_Palette{
-        {0x99, 0x66, 0x00, 0xFF},
-        {0xFF, 0xCC, 0x00, 0xFF},
-        {0xFF, 0x66, 0x00, 0xFF},
-        {0x66, 0x22, 0x00, 0xFF}
-    };
+    Planes m_Planes{};
   };
 
 } // dorito
-
@@ -90,6 +90,7 @@ struct MemoryEditor {
   void (*WriteFn)(ImU8 *data, size_t off, ImU8 d); // = 0      // optional handler to write bytes.
   bool (*HighlightFn)(const ImU8 *data,
                       size_t off);//= 0      // optional handler to return Highlight property (to support non-contiguous highlighting).
+  ImU32 (*BgColorFn)(const ImU8 *data, size_t off); // = 0 // optional handler to return custom background color of individual bytes, 0 for none.
 
   // [Internal State]
   bool ContentsWidthChanged;
@@ -121,6 +122,7 @@ struct MemoryEditor {
     ReadFn = NULL;
     WriteFn = NULL;
     HighlightFn = NULL;
+    BgColorFn = NULL;
 
     // State/Internals
     ContentsWidthChanged = false;
@@ -299,6 +301,12 @@ struct MemoryEditor {
                 highlight_width += s.SpacingBetweenMidCols;
             }
             draw_list->AddRectFilled(pos, ImVec2(pos.x + highlight_width, pos.y + s.LineHeight), HighlightColor);
+          } else if (BgColorFn) {
+            ImU32 color = BgColorFn(mem_data, addr);
+            if (color != 0) {
+              ImVec2 pos = ImGui::GetCursorScreenPos();
+              draw_list->AddRectFilled(pos, ImVec2(pos.x + s.HexCellWidth, pos.y + s.LineHeight), color);
+            }
           }
 
           if (DataEditingAddr == addr) {
@@ -14,28 +14,50 @@ namespace dorito {
         Events::InputAction,
         &Emu::HandleAction
     >(this);
+
+    Image image = GenImageColor(Display::Columns, Display::Rows, BLACK);
+    m_Screen = LoadTextureFromImage(image);
+    UnloadImage(image);
+
+    SetTextureFilter(m_Screen, TEXTURE_FILTER_POINT);
   }
 
   void Emu::OnDetach() {
     EventManager::Get().DetachAll(this);
+
+    UnloadTexture(m_Screen);
   }
 
+  // The machine runs on its own thread, this just picks up what it reported
   void Emu::Update(double) {
-    auto &bus = Bus::Get();
-    bus.Tick();
-    bus.TickTimers();
+    Bus::Get().Update();
   }
 
   void Emu::Render() {
     auto &bus = Bus::Get();
 
     const auto &palette = bus.Palette();
-    const auto &buffers = bus.Buffers();
+    const auto &frame = bus.LatestFrame();
+    const auto &buffers = frame.planes;
+
+    for (uint8_t y = 0; y < Display::Rows; y++) {
+      auto *row = &m_Pixels[y * Display::Columns];
+
+      for (uint8_t x = 0; x < Display::Columns; x++) {
+        uint8_t p1 = Display::ScreenPixel(buffers[0], frame.loresGrid, x, y);
+        uint8_t p2 = Display::ScreenPixel(buffers[1], frame.loresGrid, x, y);
+
+        row[x] = palette[p2 << 1 | p1];
+      }
+    }
+
+    // One upload and one quad rather than a rectangle per pixel
+    UpdateTexture(m_Screen, m_Pixels.data());
 
     auto scw = app.ScreenWidth();
 
-    uint8_t bufferHeight = 64;
-    uint8_t bufferWidth = 128;
+    int32_t bufferHeight = Display::Rows;
+    int32_t bufferWidth = Display::Columns;
 
     auto scale = scw / bufferWidth;
 
@@ -45,17 +67,13 @@ namespace dorito {
     auto offsetX = (texWidth - (bufferWidth * scale)) / 2;
     auto offsetY = (texHeight - (bufferHeight * scale)) / 2;
 
-    for (auto y = 0; y < bufferHeight; y++) {
-      for (auto x = 0; x < bufferWidth; x++) {
-        uint8_t p1 = buffers[0][y * bufferWidth + x];
-        uint8_t p2 = buffers[1][y * bufferWidth + x];
-        uint8_t entry = p2 << 1 | p1;
-        
-        DrawRectangle((x * scale) + offsetX, (y * scale) + offsetY,
-                      scale, scale,
-                      palette[entry]);
-      }
-    }
+    Rectangle source{0, 0, static_cast<float>(bufferWidth), static_cast<float>(bufferHeight)};
+    Rectangle dest{
+        static_cast<float>(offsetX), static_cast<float>(offsetY),
+        static_cast<float>(bufferWidth * scale), static_cast<float>(bufferHeight * scale)
+    };
+
+    DrawTexturePro(m_Screen, source, dest, {0, 0}, 0.0f, WHITE);
   }
 
   std::string Emu::Name() const noexcept {
@@ -70,6 +88,20 @@ namespace dorito {
     bool handled = true;
 
     switch (event.key) {
+      // F1-F4 load a quick save slot, with shift they save to it
+      case KEY_F1:
+      case KEY_F2:
+      case KEY_F3:
+      case KEY_F4: {
+        auto slot = static_cast<uint8_t>(event.key - KEY_F1 + 1);
+
+        if (IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT))
+          EventManager::Dispatcher().enqueue<Events::SaveStateSlot>({slot});
+        else
+          EventManager::Dispatcher().enqueue<Events::LoadStateSlot>({slot});
+      }
+        break;
+
       default:
         handled = false;
         break;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+
 #include "common/common.h"
 #include "core/Dorito.h"
 
@@ -36,6 +38,10 @@ namespace dorito {
 
   private:
     Dorito &app = Dorito::Get();
+
+    // The screen at one texel per pixel, scaled up by the GPU when drawn
+    Texture m_Screen{};
+    std::array<Color, Display::Columns * Display::Rows> m_Pixels{};
   };
 
 } // dorito
@@ -84,6 +84,8 @@ namespace dorito {
         Widget::Create<SoundEditorWidget>(),
         Widget::Create<MonitorsWidget>(),
         Widget::Create<BreakpointsWidget>(),
+        Widget::Create<TraceWidget>(),
+        Widget::Create<ProfilerWidget>(),
         Widget::Create<EditorWidget>()
     };
 
@@ -136,7 +138,6 @@ namespace dorito {
   }
 
   void UI::Render() {
-    auto &bus = Bus::Get();
     auto &io = ImGui::GetIO();
 
     const ImGuiViewport *viewport = ImGui::GetMainViewport();
@@ -164,6 +165,7 @@ namespace dorito {
       ImGui::DockSpace(dockspace_id, ImVec2(0.0f, 0.0f), ImGuiDockNodeFlags_None);
     }
 
+    // Widgets take the machine's lock themselves, just around what they read and poke
     for (auto widget: m_Widgets) {
       if (widget->Enabled())
         widget->Draw();
@@ -30,6 +30,8 @@
 #include "widgets/SoundEditorWidget.h"
 #include "widgets/MonitorsWidget.h"
 #include "widgets/BreakpointsWidget.h"
+#include "widgets/TraceWidget.h"
+#include "widgets/ProfilerWidget.h"
 
 namespace dorito {
 
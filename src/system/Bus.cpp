@@ -1,6 +1,8 @@
 #include <spdlog/spdlog.h>
 #include "Bus.h"
 
+#include <chrono>
+
 #include "config.h"
 
 #include "core/Dorito.h"
@@ -25,11 +27,36 @@ namespace dorito {
         &Bus::HandleStepCpu
     >(this);
 
+    EventManager::Get().Attach<
+        Events::StepBackCPU,
+        &Bus::HandleStepBackCpu
+    >(this);
+
+    EventManager::Get().Attach<
+        Events::SaveStateSlot,
+        &Bus::HandleSaveStateSlot
+    >(this);
+
+    EventManager::Get().Attach<
+        Events::LoadStateSlot,
+        &Bus::HandleLoadStateSlot
+    >(this);
+
+    EventManager::Get().Attach<
+        Events::RewindCPU,
+        &Bus::HandleRewindCpu
+    >(this);
+
     EventManager::Get().Attach<
         Events::ExecuteCPU,
         &Bus::HandleExecute
     >(this);
 
+    EventManager::Get().Attach<
+        Events::ExecuteUntil,
+        &Bus::HandleExecuteUntil
+    >(this);
+
     EventManager::Get().Attach<
         Events::SetCycles,
         &Bus::HandleSetCycles
@@ -80,6 +107,26 @@ namespace dorito {
         &Bus::HandleSetQuirk
     >(this);
 
+    EventManager::Get().Attach<
+        Events::SetThreaded,
+        &Bus::HandleSetThreaded
+    >(this);
+
+    EventManager::Get().Attach<
+        Events::SetMaxSpeed,
+        &Bus::HandleSetMaxSpeed
+    >(this);
+
+    EventManager::Get().Attach<
+        Events::SetJit,
+        &Bus::HandleSetJit
+    >(this);
+
+    EventManager::Get().Attach<
+        Events::SetJitChecked,
+        &Bus::HandleSetJitChecked
+    >(this);
+
     EventManager::Get().Attach<
         Events::SavePrefs,
         &Bus::HandleSavePrefs
@@ -115,57 +162,237 @@ namespace dorito {
         &Bus::HandleAddRecentSourceFile
     >(this);
 
+    EventManager::Get().Attach<
+        Events::SetColor,
+        &Bus::HandleSetColor
+    >(this);
+
+    EventManager::Get().Attach<
+        Events::SetPalette,
+        &Bus::HandleSetPalette
+    >(this);
+
+    // Raised on the emulation thread, the console belongs to the UI
+    m_Machine.OnWarning([this](const std::string &message) {
+      Notify([message] {
+        spdlog::get("console")->warn("{}", message);
+      });
+    });
+
     m_Sound = LoadAudioStream(44100, 32, 1);
     SetAudioStreamCallback(m_Sound, &Bus::AudioCallback);
     AttachAudioStreamProcessor(m_Sound, &Bus::LowpassFilterCallback);
     SetAudioStreamVolume(m_Sound, 1.0f);
 
     LoadPrefs();
+
+    m_ThreadRunning = true;
+    m_Thread = std::thread(&Bus::EmulationLoop, this);
   }
 
   Bus::~Bus() {
+    m_ThreadRunning = false;
+    m_Thread.join();
+
     DetachAudioStreamProcessor(m_Sound, &Bus::LowpassFilterCallback);
     UnloadAudioStream(m_Sound);
     EventManager::Get().DetachAll(this);
   }
 
-  uint8_t Bus::Read(uint16_t addr) {
-    return m_Ram.Read(addr);
-  }
+  void Bus::EmulationLoop() {
+    using Clock = std::chrono::steady_clock;
+
+    // One frame's worth of cycles per 60Hz timer tick, whatever the UI is doing
+    constexpr auto period = std::chrono::nanoseconds(1000000000 / 60);
 
-  void Bus::Write(uint16_t addr, uint8_t data) {
-    m_Ram.Write(addr, data);
+    // How long an uncapped run keeps the machine before checking for commands
+    constexpr auto slice = std::chrono::milliseconds(4);
+
+    auto next = Clock::now();
+    m_ThroughputStart = next;
+
+    while (m_ThreadRunning) {
+      bool uncapped;
+
+      {
+        std::lock_guard<std::recursive_mutex> lock(m_MachineLock);
+
+        Command command;
+        while (m_Commands.Pop(command)) {
+          command();
+        }
+
+        auto &cpu = m_Machine.GetCpu();
+
+        // Nothing to race through while paused or rewinding, fall back to 60Hz
+        uncapped = m_MaxSpeed && !cpu.Halted() && !m_Rewinding;
+
+        auto sliceEnd = Clock::now() + slice;
+
+        do {
+          RunFrame();
+        } while (uncapped && !cpu.Halted() && m_LockWaiters == 0 && Clock::now() < sliceEnd);
+
+        UpdateThroughput();
+
+        // Only the last frame of a slice is ever shown
+        PublishFrame();
+      }
+
+      if (uncapped) {
+        while (m_LockWaiters > 0) {
+          std::this_thread::yield();
+        }
+
+        next = Clock::now();
+        continue;
+      }
+
+      next += period;
+
+      // After a long stall pick the cadence back up rather than racing to catch up
+      auto now = Clock::now();
+      if (now - next > period * 4)
+        next = now;
+
+      std::this_thread::sleep_until(next);
+    }
   }
 
-  void Bus::WriteAudio(uint8_t position, uint8_t data) {
-    m_Ram.WriteAudio(position, data);
+  void Bus::Post(Command command) {
+    // Commands can't be dropped, wait for the emulation thread to make room
+    while (!m_Commands.Push(std::move(command))) {
+      std::this_thread::yield();
+    }
   }
 
-  uint16_t Bus::Pop() {
-    return m_Ram.Pop();
+  void Bus::Notify(Command notification) {
+    // Only ever faults and warnings, losing one while the UI is far behind is fine
+    m_Notifications.Push(std::move(notification));
   }
 
-  void Bus::Push(uint16_t addr) {
-    m_Ram.Push(addr);
+  void Bus::Update() {
+    Command notification;
+    while (m_Notifications.Pop(notification)) {
+      notification();
+    }
+
+    const auto &frame = m_Frames.Front();
+
+    if (frame.halted)
+      return;
+
+    if (frame.pitch != m_Pitch) {
+      m_Pitch = frame.pitch;
+      SetAudioStreamPitch(m_Sound, static_cast<float>(m_Pitch / 4000.0));
+    }
+
+    for (size_t n = 0; n < m_AudioPattern.size(); n++) {
+      m_AudioPattern[n].store(frame.audioPattern[n], std::memory_order_relaxed);
+    }
+
+    if (frame.soundTimer > 0) {
+      if (!IsAudioStreamPlaying(m_Sound) && !m_Muted) {
+        PlayAudioStream(m_Sound);
+      }
+    } else if (IsAudioStreamPlaying(m_Sound)) {
+      StopAudioStream(m_Sound);
+    }
   }
 
   void Bus::Tick() {
-    if (!m_Cpu.Halted()) {
-      m_Cpu.Tick(m_CyclesPerFrame);
+    if (!m_Machine.GetCpu().Halted()) {
+      m_Machine.Tick(m_CyclesPerFrame);
+      CheckMachineState();
+    }
+  }
 
-      if (m_Cpu.m_PitchDirty) {
-        SetAudioStreamPitch(m_Sound, m_Cpu.regs.pitch / 4000.0f);
-        m_Cpu.m_PitchDirty = false;
-      }
+  void Bus::RunFrame() {
+    auto &cpu = m_Machine.GetCpu();
 
-      if (m_Cpu.regs.st > 0) {
-        if (!IsAudioStreamPlaying(m_Sound) && !m_Muted) {
-          PlayAudioStream(m_Sound);
-        }
+    if (m_Rewinding) {
+      m_Rewind.FrameBack(m_Machine);
+      return;
+    }
+
+    if (cpu.Halted()) {
+      TickTimers();
+      return;
+    }
+
+    auto before = cpu.Cycles();
+
+    Tick();
+    TickTimers();
+
+    m_Rewind.Record(m_Machine);
+
+    m_ThroughputInstructions += cpu.Cycles() - before;
+    m_ThroughputFrames++;
+  }
+
+  void Bus::UpdateThroughput() {
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - m_ThroughputStart;
+
+    if (elapsed.count() < 0.5)
+      return;
+
+    m_InstructionsPerSecond = static_cast<double>(m_ThroughputInstructions) / elapsed.count();
+    m_FramesPerSecond = m_ThroughputFrames / elapsed.count();
+
+    m_ThroughputStart = now;
+    m_ThroughputInstructions = 0;
+    m_ThroughputFrames = 0;
+  }
+
+  void Bus::PublishFrame() {
+    auto &cpu = m_Machine.GetCpu();
+    auto &frame = m_Frames.Back();
+
+    frame.planes = m_Machine.Buffers();
+    frame.loresGrid = m_Machine.DisplayLoresGrid();
+    frame.soundTimer = cpu.regs.st;
+    frame.pitch = cpu.regs.pitch;
+    frame.halted = cpu.Halted();
+    frame.useBeep = m_Machine.UsingBeepBuffer();
+
+    auto pattern = m_Machine.GetRam().GetAudioBuffer();
+    std::copy_n(pattern.begin(), frame.audioPattern.size(), frame.audioPattern.begin());
+
+    frame.instructionsPerSecond = m_InstructionsPerSecond;
+    frame.framesPerSecond = m_FramesPerSecond;
+
+    m_Frames.Publish();
+  }
+
+  void Bus::CheckMachineState() {
+    auto &cpu = m_Machine.GetCpu();
+    auto &ram = m_Machine.GetRam();
+
+    // The CPU has already halted itself
+    if (cpu.BreakpointHit()) {
+      cpu.BreakpointHit(false);
+      m_Running = false;
+    }
+
+    if (ram.StackUnderflows() != m_ReportedStackUnderflows) {
+      m_ReportedStackUnderflows = ram.StackUnderflows();
+
+      if (m_ReportedStackUnderflows > 0) {
+        Notify([] {
+          EventManager::Dispatcher().enqueue(Events::StackUnderflow{});
+        });
       }
+    }
+
+    if (ram.OutOfRangeWrites() != m_ReportedOutOfRangeWrites) {
+      m_ReportedOutOfRangeWrites = ram.OutOfRangeWrites();
 
-      if (m_Cpu.regs.st == 0 && IsAudioStreamPlaying(m_Sound)) {
-        StopAudioStream(m_Sound);
+      if (m_ReportedOutOfRangeWrites > 0) {
+        Notify([addr = ram.LastOutOfRangeWrite()] {
+          EventManager::Dispatcher().enqueue(Events::OutOfRangeMemAccess{addr});
+        });
       }
     }
   }
@@ -177,13 +404,11 @@ namespace dorito {
 
     m_RomPath = path;
 
-    m_Ram.LoadRom(path);
-
-    m_Cpu.Reset();
-    m_Display.Reset();
-    SetCompatProfile(m_CompatProfile);
+    Post([this, path] {
+      m_Machine.LoadRom(path);
+      m_Rewind.Clear();
+    });
 
-    m_UseBeepBuffer = true;
     m_RecentRoms.push_back(path);
     std::vector<std::string> roms;
 
@@ -213,17 +438,112 @@ namespace dorito {
     SavePrefs();
     LoadGamePrefs();
 
-    m_Running = true;
-    m_Cpu.Halted(false);
+    Post([this] {
+      m_Running = true;
+      m_Machine.GetCpu().Halted(false);
+    });
   }
 
   void Bus::TickTimers() {
-    m_Cpu.TickTimers();
+    m_Machine.TickTimers();
   }
 
   void Bus::HandleStepCpu(const Events::StepCPU &) {
-    TickTimers();
-    m_Cpu.Step();
+    Post([this] {
+      TickTimers();
+      m_Machine.GetCpu().Step();
+      m_Rewind.Record(m_Machine);
+      CheckMachineState();
+    });
+  }
+
+  void Bus::HandleStepBackCpu(const Events::StepBackCPU &) {
+    Post([this] {
+      if (!m_Rewind.StepBack(m_Machine)) {
+        m_Machine.Warn("Nothing to step back to");
+      }
+
+      CheckMachineState();
+      PublishFrame();
+    });
+  }
+
+  void Bus::HandleRewindCpu(const Events::RewindCPU &event) {
+    m_Rewinding = event.isRewinding;
+  }
+
+  std::string Bus::StateSlotPath(uint8_t slot) const {
+    return fmt::format("{}.state{}", m_RomPath, slot);
+  }
+
+  void Bus::HandleSaveStateSlot(const Events::SaveStateSlot &event) {
+    if (m_RomPath.empty()) {
+      spdlog::get("console")->warn("Load a ROM before saving state");
+      return;
+    }
+
+    // The palette is the UI's, take it along from here
+    std::vector<uint32_t> palette;
+    for (const auto &color: m_Palette) {
+      palette.push_back((color.r << 24) | (color.g << 16) | (color.b << 8) | color.a);
+    }
+
+    Post([this, path = StateSlotPath(event.slot), slot = event.slot, palette = std::move(palette)] {
+      m_Machine.Capture(m_SaveState.snapshot);
+      m_SaveState.palette = palette;
+
+      auto error = m_SaveState.Save(path);
+
+      Notify([error, slot] {
+        if (error.empty())
+          spdlog::get("console")->info("Saved state to slot {}", slot);
+        else
+          spdlog::get("console")->error("{}", error);
+      });
+    });
+  }
+
+  void Bus::HandleLoadStateSlot(const Events::LoadStateSlot &event) {
+    if (m_RomPath.empty())
+      return;
+
+    Post([this, path = StateSlotPath(event.slot), slot = event.slot] {
+      auto error = m_SaveState.Load(path);
+
+      if (!error.empty()) {
+        Notify([error] {
+          spdlog::get("console")->error("{}", error);
+        });
+
+        return;
+      }
+
+      m_Machine.Restore(m_SaveState.snapshot);
+
+      // History from before the load doesn't lead here
+      m_Rewind.Clear();
+      m_Rewind.Record(m_Machine);
+
+      CheckMachineState();
+      PublishFrame();
+
+      std::vector<Color> palette;
+      for (auto rgba: m_SaveState.palette) {
+        palette.push_back({
+                              static_cast<uint8_t>(rgba >> 24),
+                              static_cast<uint8_t>(rgba >> 16),
+                              static_cast<uint8_t>(rgba >> 8),
+                              static_cast<uint8_t>(rgba)
+                          });
+      }
+
+      Notify([palette = std::move(palette), slot] {
+        if (palette.size() == SaveState::PaletteSize)
+          EventManager::Dispatcher().trigger<Events::SetPalette>(Events::SetPalette{palette});
+
+        spdlog::get("console")->info("Loaded state from slot {}", slot);
+      });
+    });
   }
 
   void Bus::HandleLoadRom(const Events::LoadROM &event) {
@@ -231,25 +551,59 @@ namespace dorito {
   }
 
   void Bus::HandleExecute(const Events::ExecuteCPU &event) {
-    m_Cpu.Halted(!event.execute);
-    m_Running = event.execute;
+    Post([this, execute = event.execute] {
+      m_Machine.GetCpu().Halted(!execute);
+      m_Running = execute;
+    });
+  }
+
+  void Bus::HandleExecuteUntil(const Events::ExecuteUntil &event) {
+    Post([this, addr = event.addr, budget = event.budget] {
+      auto &cpu = m_Machine.GetCpu();
+
+      // All in one go on this thread, the UI only sees where it ended up
+      auto before = cpu.Cycles();
+
+      cpu.Halted(false);
+      bool reached = m_Machine.RunUntil(addr, budget, m_CyclesPerFrame);
+      cpu.Halted(true);
+
+      m_Rewind.Record(m_Machine);
+
+      m_ThroughputInstructions += cpu.Cycles() - before;
+
+      bool stopped = cpu.BreakpointHit();
+      CheckMachineState();
+      m_Running = false;
+
+      if (!reached && !stopped) {
+        m_Machine.Warn(fmt::format("Didn't reach 0x{:04X} within {} instructions", addr, cpu.Cycles() - before));
+      }
+
+      PublishFrame();
+    });
   }
 
   void Bus::HandleSetCycles(const Events::SetCycles &event) {
-    m_CyclesPerFrame = event.cycles;
+    Post([this, cycles = event.cycles] {
+      m_CyclesPerFrame = cycles;
+    });
   }
 
   void Bus::HandleReset(const Events::Reset &) {
-    m_Cpu.Reset();
-    m_Display.Reset();
-    m_Ram.Reset();
+    Post([this] {
+      m_Machine.Reset();
+      m_Rewind.Clear();
+    });
 
     if (!m_RomPath.empty()) {
       LoadRom(m_RomPath);
     }
 
-    SetCompatProfile(m_CompatProfile);
-    m_Running = false;
+    Post([this] {
+      m_Machine.SetCompatProfile(m_Machine.GetCompatProfile());
+      m_Running = false;
+    });
   }
 
   void Bus::HandleUnload(const Events::UnloadROM &) {
@@ -257,11 +611,12 @@ namespace dorito {
       StopAudioStream(m_Sound);
     }
 
-    m_Ram.Reset();
-    m_Cpu.Reset();
-    m_Display.Reset();
-    SetCompatProfile(m_CompatProfile);
-    m_Running = false;
+    Post([this] {
+      m_Machine.Reset();
+      m_Rewind.Clear();
+      m_Machine.SetCompatProfile(m_Machine.GetCompatProfile());
+      m_Running = false;
+    });
   }
 
   void Bus::HandleKeyDown(const Events::KeyDown &event) {
@@ -337,7 +692,9 @@ namespace dorito {
     }
 
     if (index > -1) {
-      m_Cpu.SetKeyState(index, true);
+      Post([this, index] {
+        m_Machine.GetCpu().SetKeyState(index, true);
+      });
     }
   }
 
@@ -414,7 +771,9 @@ namespace dorito {
     }
 
     if (index > -1) {
-      m_Cpu.SetKeyState(index, false);
+      Post([this, index] {
+        m_Machine.GetCpu().SetKeyState(index, false);
+      });
     }
   }
 
@@ -491,47 +850,16 @@ namespace dorito {
     }
 
     if (index > -1) {
-      m_Cpu.KeyPressed(index);
+      Post([this, index] {
+        m_Machine.GetCpu().KeyPressed(index);
+      });
     }
   }
 
   void Bus::SetCompatProfile(const Bus::CompatProfile &profile) {
-    m_CompatProfile = profile;
-
-    m_Cpu.SetQuirks(
-        {
-            Chip8::Quirk::Clip,
-            Chip8::Quirk::Logic,
-            Chip8::Quirk::Jump,
-            Chip8::Quirk::LoadStore,
-            Chip8::Quirk::Shift,
-            Chip8::Quirk::LoresSprites,
-            Chip8::Quirk::VBlank,
-            Chip8::Quirk::IRegCarry
-        }, false);
-
-    switch (profile) {
-      case CompatProfile::VIP:
-        m_Cpu.SetQuirks(
-            {
-                Chip8::Quirk::Logic,
-                Chip8::Quirk::Clip,
-                Chip8::Quirk::VBlank
-            }, true);
-        break;
-      case CompatProfile::SCHIP:
-        m_Cpu.SetQuirks(
-            {
-                Chip8::Quirk::Shift,
-                Chip8::Quirk::LoadStore,
-                Chip8::Quirk::Jump,
-                Chip8::Quirk::Clip
-            }, true);
-        break;
-
-      default:
-        break;
-    }
+    Post([this, profile] {
+      m_Machine.SetCompatProfile(profile);
+    });
   }
 
   void Bus::HandleVIPCompat(const Events::VIPCompat &) {
@@ -551,13 +879,37 @@ namespace dorito {
   }
 
   void Bus::SetQuirk(Chip8::Quirk quirk, bool isSet) {
-    m_Cpu.SetQuirks({quirk}, isSet);
+    Post([this, quirk, isSet] {
+      m_Machine.SetQuirk(quirk, isSet);
+    });
   }
 
   void Bus::HandleSetQuirk(const Events::SetQuirk &event) {
     SetQuirk(event.quirk, event.value);
   }
 
+  void Bus::HandleSetThreaded(const Events::SetThreaded &event) {
+    Post([this, isSet = event.isSet] {
+      m_Machine.GetCpu().Threaded(isSet);
+    });
+  }
+
+  void Bus::HandleSetMaxSpeed(const Events::SetMaxSpeed &event) {
+    m_MaxSpeed = event.isSet;
+  }
+
+  void Bus::HandleSetJit(const Events::SetJit &event) {
+    Post([this, isSet = event.isSet] {
+      m_Machine.GetCpu().Jit(isSet);
+    });
+  }
+
+  void Bus::HandleSetJitChecked(const Events::SetJitChecked &event) {
+    Post([this, isSet = event.isSet] {
+      m_Machine.GetCpu().JitChecked(isSet);
+    });
+  }
+
   void Bus::HandleSetMute(const Events::SetMute &event) {
     m_Muted = event.isSet;
 
@@ -569,13 +921,16 @@ namespace dorito {
   }
 
   void Bus::HandleRunCode(const Events::RunCode &event) {
-    m_Cpu.Reset();
-    m_Display.Reset();
-    m_Ram.Reset();
-    m_Ram.LoadRom(event.rom);
+    // The compiled program belongs to the editor, take a copy of the whole address space
+    std::vector<char> rom(event.rom, event.rom + 0x10000);
+
+    Post([this, rom = std::move(rom)] {
+      m_Machine.LoadRom(rom.data());
+      m_Rewind.Clear();
 
-    m_Cpu.Halted(false);
-    m_Running = true;
+      m_Machine.GetCpu().Halted(false);
+      m_Running = true;
+    });
   }
 
   void Bus::HandleClearRecents(const Events::UIClearRecents &) {
@@ -597,6 +952,14 @@ namespace dorito {
     SavePrefs();
   }
 
+  void Bus::HandleSetColor(const Events::SetColor &event) {
+    m_Palette[event.index] = event.color;
+  }
+
+  void Bus::HandleSetPalette(const Events::SetPalette &event) {
+    m_Palette = event.palette;
+  }
+
   void Bus::AudioCallback(void *buffer, uint32_t frames) {
     static uint32_t cursor = 0;
     std::vector<float> bits;
@@ -604,7 +967,12 @@ namespace dorito {
     float *output = (float *) buffer;
 
     auto &bus = Bus::Get();
-    auto &pattern = bus.m_Ram.GetAudioBuffer();
+
+    // Never the machine's own buffer, the emulation thread may be writing it
+    std::vector<uint8_t> pattern(bus.m_AudioPattern.size());
+    for (size_t n = 0; n < pattern.size(); n++) {
+      pattern[n] = bus.m_AudioPattern[n].load(std::memory_order_relaxed);
+    }
 
     /* Stolen from Timendus' excellent silicon8.
     * https://github.com/Timendus/silicon8/blob/ec8dc770a0305d3782881cdc8bb4eed5c954bca0/web-client/sound.js
@@ -666,12 +1034,14 @@ namespace dorito {
     if (prefs) {
       m_GamePrefs = nlohmann::json::parse(prefs);
 
-      uint8_t n = 0;
-      for (const auto &q: m_GamePrefs.quirks) {
-        m_Cpu.regs.quirks[n++] = q;
-      }
+      Post([this, quirks = m_GamePrefs.quirks, cycles = m_GamePrefs.cyclesPerFrame] {
+        uint8_t n = 0;
+        for (bool q: quirks) {
+          m_Machine.SetQuirk(static_cast<Chip8::Quirk>(n++), q);
+        }
 
-      m_CyclesPerFrame = m_GamePrefs.cyclesPerFrame;
+        m_CyclesPerFrame = cycles;
+      });
 
       EventManager::Dispatcher().trigger<Events::SetPalette>(Events::SetPalette{m_GamePrefs.palette});
 
@@ -683,16 +1053,20 @@ namespace dorito {
     if (m_RomPath.empty())
       return;
 
+    auto lock = Lock();
+
     m_GamePrefs.cyclesPerFrame = m_CyclesPerFrame;
-    m_GamePrefs.palette = m_Display.Palette();
+    m_GamePrefs.palette = m_Palette;
 
     std::vector<bool> qvec;
-    for (auto q: m_Cpu.regs.quirks) {
+    for (auto q: m_Machine.GetCpu().regs.quirks) {
       qvec.push_back(q);
     }
 
     m_GamePrefs.quirks = qvec;
 
+    lock.unlock();
+
     json prefs = m_GamePrefs;
 
     auto prefsPath = fmt::format("{}.prefs", m_RomPath);
@@ -2,25 +2,49 @@
 
 #include <raylib.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "core/events/EventManager.h"
 
-#include "cpu/Chip8.h"
-#include "cpu/Memory.h"
-#include "display/Display.h"
+#include "Machine.h"
+#include "Rewind.h"
+#include "SaveState.h"
 
 #include "common/Preferences.h"
+#include "common/SpscQueue.h"
+#include "common/TripleBuffer.h"
 
 namespace dorito {
 
   class Bus {
   public:
-    enum class CompatProfile {
-      VIP,
-      SCHIP,
-      XOChip
+    using CompatProfile = Machine::CompatProfile;
+
+    using Command = std::function<void()>;
+
+    // What the emulation thread hands the UI after every frame
+    struct Frame {
+      Display::Planes planes{};
+      bool loresGrid = true;
+
+      uint8_t soundTimer = 0;
+      double pitch = 4000.0;
+      bool halted = true;
+
+      // What the speaker plays, the beep until F002 or FX3A switch to the pattern
+      std::array<uint8_t, Memory::AudioPatternSize> audioPattern{};
+      bool useBeep = true;
+
+      // Measured over the last half second or so of emulation
+      double instructionsPerSecond = 0.0;
+      double framesPerSecond = 0.0;
     };
 
   public:
@@ -31,84 +55,53 @@ namespace dorito {
     }
 
   public:
-    void Tick();
-
-    void TickTimers();
+    // UI thread, delivers what the machine reported and drives the audio stream
+    void Update();
 
     void LoadRom(const std::string &path);
 
-    uint8_t Read(uint16_t addr);
-
-    void Write(uint16_t addr, uint8_t data);
-
-    void WriteAudio(uint8_t position, uint8_t data);
-
-    uint16_t Pop();
-
-    void Push(uint16_t addr);
-
-    void ClearScreen() { m_Display.Clear(); }
-
-    void ScrollUp(uint8_t count) { m_Display.ScrollUp(count); }
-
-    void ScrollDown(uint8_t count) { m_Display.ScrollDown(count); }
-
-    void ScrollRight() { m_Display.ScrollRight(4); }
-
-    void ScrollLeft() { m_Display.ScrollLeft(4); }
-
-    void SetHighRes(bool isSet) {
-      m_Display.HighRes(isSet);
-      auto mask = m_Display.PlaneMask();
-      m_Display.PlaneMask(0x3);
-      m_Display.Clear();
-      m_Display.PlaneMask(mask);
-    }
-
-    bool Plot(uint8_t plane, uint8_t x, uint8_t y) {
-      return m_Display.Plot(plane, x, y);
-    }
+    void SetQuirk(Chip8::Quirk quirk, bool isSet);
 
-    uint16_t CharacterAddress(uint8_t character) {
-      return m_Ram.CharacterAddress(character);
+    void Muted(bool isMuted) {
+      m_Muted = isMuted;
     }
 
-    uint16_t BigCharacterAddress(uint8_t character) {
-      return m_Ram.BigCharacterAddress(character);
-    }
+    void AddRecentSourceFile(const std::string &path);
 
-    void SetQuirk(Chip8::Quirk quirk, bool isSet);
+    /* The emulation thread holds this while it runs a frame. Anything on
+     * the UI thread reading or poking the machine directly takes it too.
+     */
+    [[nodiscard]] std::unique_lock<std::recursive_mutex> Lock() {
+      // Lets an uncapped emulation thread know to step aside for a moment
+      m_LockWaiters++;
+      std::unique_lock<std::recursive_mutex> lock(m_MachineLock);
+      m_LockWaiters--;
 
-    void SetPlane(uint8_t plane) {
-      m_Display.PlaneMask(plane);
+      return lock;
     }
 
-    uint8_t GetPlane() {
-      return m_Display.PlaneMask();
+    // Newest completed frame, UI thread only
+    [[nodiscard]] const Frame &LatestFrame() {
+      return m_Frames.Front();
     }
 
-    void UseBeepBuffer(bool use) {
-      m_UseBeepBuffer = use;
-      m_Ram.UseBeep(use);
-    }
+    static constexpr uint8_t StateSlots = 4;
 
-    void Muted(bool isMuted) {
-      m_Muted = isMuted;
+  public:
+    Machine &GetMachine() {
+      return m_Machine;
     }
 
-    void AddRecentSourceFile(const std::string &path);
-
-  public:
     Display &GetDisplay() {
-      return m_Display;
+      return m_Machine.GetDisplay();
     }
 
     Chip8 &GetCpu() {
-      return m_Cpu;
+      return m_Machine.GetCpu();
     }
 
     Memory &GetRam() {
-      return m_Ram;
+      return m_Machine.GetRam();
     }
 
     [[nodiscard]] const std::vector<std::string> &RecentRoms() const {
@@ -124,19 +117,19 @@ namespace dorito {
     }
 
     [[nodiscard]] uint8_t DisplayWidth() const {
-      return m_Display.Width();
+      return m_Machine.DisplayWidth();
     }
 
     [[nodiscard]] uint8_t DisplayHeight() const {
-      return m_Display.Height();
+      return m_Machine.DisplayHeight();
     }
 
     [[nodiscard]] std::vector<bool> Quirks() const {
-      return m_Cpu.GetQuirks();
+      return m_Machine.Quirks();
     }
 
     [[nodiscard]] CompatProfile GetCompatProfile() const {
-      return m_CompatProfile;
+      return m_Machine.GetCompatProfile();
     }
 
     [[nodiscard]] uint16_t CyclesPerFrame() const {
@@ -144,15 +137,13 @@ namespace dorito {
     }
 
     [[nodiscard]] const std::vector<Color> &Palette() const {
-      return m_Display.Palette();
-    }
-
-    [[nodiscard]] const std::vector<std::vector<uint8_t>> &Buffers() const {
-      return m_Display.Buffers();
+      return m_Palette;
     }
 
     [[nodiscard]] bool Running() const { return m_Running; }
 
+    [[nodiscard]] bool MaxSpeed() const { return m_MaxSpeed; }
+
     [[nodiscard]] const std::string &Path() const { return m_RomPath; }
 
   private:
@@ -166,8 +157,31 @@ namespace dorito {
     static void LowpassFilterCallback(void *buffer, uint32_t frames);
 
   private:
+    void EmulationLoop();
+
+    // Runs the command on the emulation thread before its next frame
+    void Post(Command command);
+
+    // Runs the notification on the UI thread during the next Update
+    void Notify(Command notification);
+
+    void Tick();
+
+    void TickTimers();
+
+    // One emulated frame, Tick and TickTimers, counted towards the throughput
+    void RunFrame();
+
+    void UpdateThroughput();
+
+    void PublishFrame();
+
     void SetCompatProfile(const CompatProfile &profile);
 
+    [[nodiscard]] std::string StateSlotPath(uint8_t slot) const;
+
+    void CheckMachineState();
+
     void SaveGamePrefs();
 
     void LoadGamePrefs();
@@ -181,8 +195,18 @@ namespace dorito {
 
     void HandleStepCpu(const Events::StepCPU &event);
 
+    void HandleStepBackCpu(const Events::StepBackCPU &event);
+
+    void HandleSaveStateSlot(const Events::SaveStateSlot &event);
+
+    void HandleLoadStateSlot(const Events::LoadStateSlot &event);
+
+    void HandleRewindCpu(const Events::RewindCPU &event);
+
     void HandleExecute(const Events::ExecuteCPU &event);
 
+    void HandleExecuteUntil(const Events::ExecuteUntil &event);
+
     void HandleSetCycles(const Events::SetCycles &event);
 
     void HandleReset(const Events::Reset &event);
@@ -203,6 +227,14 @@ namespace dorito {
 
     void HandleSetQuirk(const Events::SetQuirk &event);
 
+    void HandleSetThreaded(const Events::SetThreaded &event);
+
+    void HandleSetMaxSpeed(const Events::SetMaxSpeed &event);
+
+    void HandleSetJit(const Events::SetJit &event);
+
+    void HandleSetJitChecked(const Events::SetJitChecked &event);
+
     void HandleSavePrefs(const Events::SavePrefs &event);
 
     void HandleSaveAppPrefs(const Events::SaveAppPrefs &event);
@@ -217,22 +249,68 @@ namespace dorito {
 
     void HandleAddRecentSourceFile(const Events::UIAddRecentSourceFile &event);
 
+    void HandleSetColor(const Events::SetColor &event);
+
+    void HandleSetPalette(const Events::SetPalette &event);
+
   private:
     friend class UI;
 
   private:
-    Chip8 m_Cpu;
-    Memory m_Ram;
-    Display m_Display;
+    Machine m_Machine;
 
-    uint16_t m_CyclesPerFrame = 100;
-    bool m_Running = false;
-    bool m_UseBeepBuffer = true;
-    bool m_Muted = false;
+    std::thread m_Thread;
+    std::atomic<bool> m_ThreadRunning = false;
+    std::recursive_mutex m_MachineLock;
+    std::atomic<uint32_t> m_LockWaiters = 0;
+
+    // Run frames back to back instead of at 60Hz
+    std::atomic<bool> m_MaxSpeed = false;
+
+    // Emulation thread only, recorded after every frame and step that ran
+    Rewind m_Rewind;
+
+    // Frames go backwards instead of forwards while set
+    std::atomic<bool> m_Rewinding = false;
+
+    // Emulation thread only, kept around so quick saves reuse its buffers
+    SaveState m_SaveState;
 
-    CompatProfile m_CompatProfile = CompatProfile::XOChip;
+    SpscQueue<Command, 1024> m_Commands;
+    SpscQueue<Command, 256> m_Notifications;
+    TripleBuffer<Frame> m_Frames;
 
+    // Emulation thread only, throughput since m_ThroughputStart
+    std::chrono::steady_clock::time_point m_ThroughputStart;
+    uint64_t m_ThroughputInstructions = 0;
+    uint32_t m_ThroughputFrames = 0;
+    double m_InstructionsPerSecond = 0.0;
+    double m_FramesPerSecond = 0.0;
+
+    // UI side copy, the machine's is only safe to read on the emulation thread
     std::string m_RomPath;
+    double m_Pitch = 4000.0;
+
+    // The audio thread's copy of the latest frame's pattern
+    std::array<std::atomic<uint8_t>, Memory::AudioPatternSize> m_AudioPattern{};
+
+    // Changed by commands on the emulation thread, read by widgets without the lock
+    std::atomic<uint16_t> m_CyclesPerFrame = 100;
+    std::atomic<bool> m_Running = false;
+
+    bool m_Muted = false;
+
+    // Machine faults already turned into events
+    uint32_t m_ReportedStackUnderflows = 0;
+    uint32_t m_ReportedOutOfRangeWrites = 0;
+
+    std::vector<Color> m_Palette{
+        {0x99, 0x66, 0x00, 0xFF},
+        {0xFF, 0xCC, 0x00, 0xFF},
+        {0xFF, 0x66, 0x00, 0xFF},
+        {0x66, 0x22, 0x00, 0xFF}
+    };
+
     GamePrefs m_GamePrefs;
 
     DoritoPrefs m_Prefs;
@@ -0,0 +1,133 @@
+#include "Machine.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace dorito {
+  Machine::Machine() : m_Cpu(*this) {
+    m_Cpu.Attach(m_Ram, m_Display);
+    SetCompatProfile(m_CompatProfile);
+  }
+
+  void Machine::Tick(uint32_t cycles) {
+    m_Cpu.Tick(cycles);
+  }
+
+  void Machine::TickTimers() {
+    m_Cpu.TickTimers();
+  }
+
+  bool Machine::RunUntil(uint16_t addr, uint64_t budget, uint32_t cyclesPerFrame) {
+    if (cyclesPerFrame == 0)
+      return false;
+
+    auto start = m_Cpu.Cycles();
+
+    while (m_Cpu.Cycles() - start < budget) {
+      if (m_Cpu.Halted() || m_Cpu.Waiting())
+        return false;
+
+      auto left = budget - (m_Cpu.Cycles() - start);
+
+      // The frame it gets there in is cut short, so its timer tick waits for the next
+      if (m_Cpu.TickUntil(addr, static_cast<uint32_t>(std::min<uint64_t>(cyclesPerFrame, left))))
+        return true;
+
+      m_Cpu.TickTimers();
+    }
+
+    return false;
+  }
+
+  void Machine::Capture(Snapshot &snapshot) {
+    const auto &ram = m_Ram.GetMemory();
+    const auto &stack = m_Ram.GetStack();
+
+    snapshot.cpu = m_Cpu.GetState();
+    snapshot.random = m_Cpu.RandomEngine();
+
+    snapshot.ram.assign(ram.begin(), ram.end());
+    snapshot.stack.assign(stack.begin(), stack.end());
+    snapshot.audioPattern = m_Ram.AudioPattern();
+    snapshot.useBeep = m_UseBeepBuffer;
+
+    snapshot.planes = m_Display.Buffers();
+    snapshot.planeMask = m_Display.PlaneMask();
+    snapshot.displayHighRes = m_Display.HighRes();
+    snapshot.displayLoresGrid = m_Display.LoresGrid();
+  }
+
+  void Machine::Restore(const Snapshot &snapshot) {
+    auto &ram = m_Ram.GetMemory();
+    auto &stack = m_Ram.GetStack();
+
+    for (uint32_t page = 0; page < 0x10000; page += 0x100) {
+      if (memcmp(&ram[page], &snapshot.ram[page], 0x100) == 0)
+        continue;
+
+      memcpy(&ram[page], &snapshot.ram[page], 0x100);
+      m_Cpu.InvalidateRange(page, page + 0x100);
+    }
+
+    m_Cpu.SetState(snapshot.cpu);
+    m_Cpu.RandomEngine(snapshot.random);
+
+    stack.assign(snapshot.stack.begin(), snapshot.stack.end());
+    m_Ram.AudioPattern() = snapshot.audioPattern;
+    UseBeepBuffer(snapshot.useBeep);
+
+    m_Display.HighRes(snapshot.displayHighRes);
+    m_Display.Buffers(snapshot.planes, snapshot.displayLoresGrid);
+    m_Display.PlaneMask(snapshot.planeMask);
+  }
+
+  void Machine::Reset() {
+    m_Cpu.Reset();
+    m_Display.Reset();
+    m_Ram.Reset();
+  }
+
+  void Machine::LoadRom(const std::string &path) {
+    m_RomPath = path;
+
+    m_Ram.LoadRom(path);
+
+    m_Cpu.Reset();
+    m_Display.Reset();
+    SetCompatProfile(m_CompatProfile);
+    m_Cpu.Analyze();
+
+    m_UseBeepBuffer = true;
+  }
+
+  void Machine::LoadRom(const char *rom) {
+    Reset();
+
+    m_Ram.LoadRom(rom);
+    m_Cpu.FlushDecoded();
+    m_Cpu.Analyze();
+  }
+
+  void Machine::SetCompatProfile(const CompatProfile &profile) {
+    m_CompatProfile = profile;
+
+    switch (profile) {
+      case CompatProfile::VIP:
+        m_Cpu.SetQuirks(Chip8::VIPQuirks);
+        break;
+
+      case CompatProfile::SCHIP:
+        m_Cpu.SetQuirks(Chip8::SCHIPQuirks);
+        break;
+
+      default:
+        m_Cpu.SetQuirks(Chip8::XOChipQuirks);
+        break;
+    }
+  }
+
+  void Machine::SetQuirk(Chip8::Quirk quirk, bool isSet) {
+    m_Cpu.SetQuirks({quirk}, isSet);
+  }
+
+} // dorito
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "cpu/Chip8.h"
+#include "cpu/Memory.h"
+#include "display/Display.h"
+
+namespace dorito {
+
+  /* Everything needed to run a program: CPU, memory and display with
+   * no window, audio device or preferences attached. Bus wraps one for
+   * the app, anything headless can create as many as it likes.
+   */
+  class Machine {
+  public:
+    enum class CompatProfile {
+      VIP,
+      SCHIP,
+      XOChip
+    };
+
+    using WarningHandler = std::function<void(const std::string &message)>;
+
+    // The whole machine at one moment, enough to carry on from exactly there
+    struct Snapshot {
+      Chip8::State cpu{};
+      std::mt19937 random{};
+
+      std::vector<uint8_t> ram{};
+      std::vector<uint16_t> stack{};
+      std::vector<uint8_t> audioPattern{};
+      bool useBeep = true;
+
+      Display::Planes planes{};
+      uint8_t planeMask = 0x1;
+      bool displayHighRes = false;
+      bool displayLoresGrid = true;
+    };
+
+  public:
+    Machine();
+
+    Machine(const Machine &) = delete;
+
+    Machine &operator=(const Machine &) = delete;
+
+    void Tick(uint32_t cycles);
+
+    void TickTimers();
+
+    /* Runs frames of cyclesPerFrame instructions, ticking the timers
+     * after each, until pc reaches addr or budget instructions have run.
+     * True when it got there; false means the budget ran out or the CPU
+     * stopped for something else first, such as a breakpoint or a key wait.
+     */
+    bool RunUntil(uint16_t addr, uint64_t budget, uint32_t cyclesPerFrame);
+
+    // Reuses the snapshot's storage, so capturing into the same one again doesn't allocate
+    void Capture(Snapshot &snapshot);
+
+    // Only invalidates decoded code on the RAM pages that differ
+    void Restore(const Snapshot &snapshot);
+
+    void Reset();
+
+    void LoadRom(const std::string &path);
+
+    void LoadRom(const char *rom);
+
+    void SetCompatProfile(const CompatProfile &profile);
+
+    void SetQuirk(Chip8::Quirk quirk, bool isSet);
+
+    void OnWarning(WarningHandler handler) {
+      m_WarningHandler = std::move(handler);
+    }
+
+    void Warn(const std::string &message) {
+      if (m_WarningHandler)
+        m_WarningHandler(message);
+    }
+
+  public:
+    uint8_t Read(uint16_t addr) {
+      return m_Ram.Read(addr);
+    }
+
+    void Write(uint16_t addr, uint8_t data) {
+      m_Ram.Write(addr, data);
+      m_Cpu.InvalidateDecoded(addr);
+    }
+
+    void WriteAudio(uint8_t position, uint8_t data) {
+      m_Ram.WriteAudio(position, data);
+    }
+
+    uint16_t Pop() { return m_Ram.Pop(); }
+
+    void Push(uint16_t addr) { m_Ram.Push(addr); }
+
+    void ClearScreen() { m_Display.Clear(); }
+
+    void ScrollUp(uint8_t count) { m_Display.ScrollUp(count); }
+
+    void ScrollDown(uint8_t count) { m_Display.ScrollDown(count); }
+
+    void ScrollRight() { m_Display.ScrollRight(4); }
+
+    void ScrollLeft() { m_Display.ScrollLeft(4); }
+
+    void SetHighRes(bool isSet) {
+      m_Display.HighRes(isSet);
+      auto mask = m_Display.PlaneMask();
+      m_Display.PlaneMask(0x3);
+      m_Display.Clear();
+      m_Display.PlaneMask(mask);
+    }
+
+    uint16_t CharacterAddress(uint8_t character) {
+      return m_Ram.CharacterAddress(character);
+    }
+
+    uint16_t BigCharacterAddress(uint8_t character) {
+      return m_Ram.BigCharacterAddress(character);
+    }
+
+    void SetPlane(uint8_t plane) {
+      m_Display.PlaneMask(plane);
+    }
+
+    uint8_t GetPlane() {
+      return m_Display.PlaneMask();
+    }
+
+    void UseBeepBuffer(bool use) {
+      m_UseBeepBuffer = use;
+      m_Ram.UseBeep(use);
+    }
+
+  public:
+    Chip8 &GetCpu() {
+      return m_Cpu;
+    }
+
+    Memory &GetRam() {
+      return m_Ram;
+    }
+
+    Display &GetDisplay() {
+      return m_Display;
+    }
+
+    [[nodiscard]] CompatProfile GetCompatProfile() const {
+      return m_CompatProfile;
+    }
+
+    [[nodiscard]] uint8_t DisplayWidth() const {
+      return m_Display.Width();
+    }
+
+    [[nodiscard]] uint8_t DisplayHeight() const {
+      return m_Display.Height();
+    }
+
+    [[nodiscard]] bool DisplayLoresGrid() const {
+      return m_Display.LoresGrid();
+    }
+
+    [[nodiscard]] const Display::Planes &Buffers() const {
+      return m_Display.Buffers();
+    }
+
+    [[nodiscard]] std::vector<bool> Quirks() const {
+      return m_Cpu.GetQuirks();
+    }
+
+    [[nodiscard]] bool UsingBeepBuffer() const { return m_UseBeepBuffer; }
+
+    [[nodiscard]] const std::string &Path() const { return m_RomPath; }
+
+  private:
+    Chip8 m_Cpu;
+    Memory m_Ram;
+    Display m_Display;
+
+    CompatProfile m_CompatProfile = CompatProfile::XOChip;
+
+    std::string m_RomPath;
+    bool m_UseBeepBuffer = true;
+
+    WarningHandler m_WarningHandler;
+  };
+
+} // dorito
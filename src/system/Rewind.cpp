@@ -0,0 +1,301 @@
+#include "Rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace dorito {
+  namespace {
+    constexpr uint32_t PageSize = 0x100;
+    constexpr size_t RowBytes = 2 * sizeof(uint64_t);
+  }
+
+  Rewind::Rewind(uint32_t keyframeInterval, size_t budget)
+      : m_KeyframeInterval(std::max<uint32_t>(keyframeInterval, 1)), m_Budget(budget) {}
+
+  void Rewind::Record(Machine &machine) {
+    auto &cpu = machine.GetCpu();
+
+    // The machine was reset or loaded something new, the history is for another program
+    if (!m_Segments.empty() && cpu.Cycles() < m_Segments.back().records.back().cpu.cycles)
+      Clear();
+
+    if (m_Segments.empty() || m_Segments.back().records.size() >= m_KeyframeInterval) {
+      StartSegment(machine);
+      Trim();
+      return;
+    }
+
+    auto &segment = m_Segments.back();
+    auto &data = segment.data;
+    auto start = data.size();
+
+    Entry record{};
+    record.cpu = cpu.GetState();
+    record.offset = static_cast<uint32_t>(start);
+
+    const auto &ram = machine.GetRam().GetMemory();
+
+    for (uint32_t page = 0; page < 0x10000; page += PageSize) {
+      if (memcmp(&ram[page], &m_ShadowRam[page], PageSize) == 0)
+        continue;
+
+      data.push_back(static_cast<uint8_t>(page >> 8));
+      data.insert(data.end(), ram.begin() + page, ram.begin() + page + PageSize);
+      memcpy(&m_ShadowRam[page], &ram[page], PageSize);
+
+      record.pages++;
+    }
+
+    const auto &planes = machine.GetDisplay().Buffers();
+
+    for (uint8_t plane = 0; plane < planes.size(); plane++) {
+      for (uint8_t row = 0; row < Display::Rows; row++) {
+        const auto *words = &planes[plane][row * 2];
+        auto *shadow = &m_ShadowPlanes[plane][row * 2];
+
+        if (words[0] == shadow[0] && words[1] == shadow[1])
+          continue;
+
+        auto at = data.size();
+        data.resize(at + 2 + RowBytes);
+        data[at] = plane;
+        data[at + 1] = row;
+        memcpy(&data[at + 2], words, RowBytes);
+
+        shadow[0] = words[0];
+        shadow[1] = words[1];
+
+        record.rows++;
+      }
+    }
+
+    const auto &stack = machine.GetRam().GetStack();
+    record.stackSize = static_cast<uint16_t>(std::min(stack.size(), Memory::StackLimit));
+
+    for (uint16_t n = 0; n < record.stackSize; n++) {
+      data.push_back(stack[n] & 0xFF);
+      data.push_back(stack[n] >> 8);
+    }
+
+    const auto &display = machine.GetDisplay();
+    record.planeMask = display.PlaneMask();
+    record.displayHighRes = display.HighRes();
+    record.displayLoresGrid = display.LoresGrid();
+    record.useBeep = machine.UsingBeepBuffer();
+    std::copy_n(machine.GetRam().AudioPattern().begin(), 16, record.audioPattern);
+
+    segment.records.push_back(record);
+
+    auto added = sizeof(Entry) + data.size() - start;
+    segment.bytes += added;
+    m_Bytes += added;
+
+    Trim();
+  }
+
+  bool Rewind::FrameBack(Machine &machine) {
+    if (m_Segments.empty())
+      return false;
+
+    auto last = m_Segments.size() - 1;
+    auto &records = m_Segments[last].records;
+
+    // Part way into a frame, going back to where it started is enough
+    if (machine.GetCpu().Cycles() != records.back().cpu.cycles) {
+      RestoreTo(machine, last, records.size() - 1);
+      return true;
+    }
+
+    if (records.size() > 1) {
+      RestoreTo(machine, last, records.size() - 2);
+      return true;
+    }
+
+    if (last == 0)
+      return false;
+
+    m_Bytes -= m_Segments.back().bytes;
+    m_Segments.pop_back();
+
+    RestoreTo(machine, last - 1, m_Segments.back().records.size() - 1);
+
+    return true;
+  }
+
+  bool Rewind::StepBack(Machine &machine) {
+    auto &cpu = machine.GetCpu();
+    auto cycles = cpu.Cycles();
+
+    if (m_Segments.empty() || cycles == 0)
+      return false;
+
+    auto target = cycles - 1;
+
+    // Keys only change between frames, so these are what the frame being replayed saw
+    auto keys = cpu.GetState().regs;
+
+    for (size_t segment = m_Segments.size(); segment-- > 0;) {
+      const auto &records = m_Segments[segment].records;
+
+      for (size_t index = records.size(); index-- > 0;) {
+        const auto &record = records[index];
+
+        if (record.cpu.cycles > target) {
+          keys = record.cpu.regs;
+          continue;
+        }
+
+        auto replay = target - record.cpu.cycles;
+
+        RestoreTo(machine, segment, index);
+
+        for (uint8_t key = 0; key < 16; key++) {
+          cpu.SetKeyState(key, keys.keys[key]);
+        }
+
+        cpu.Replay(replay);
+
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void Rewind::Clear() {
+    m_Segments.clear();
+    m_Bytes = 0;
+  }
+
+  size_t Rewind::Records() const {
+    size_t count = 0;
+
+    for (const auto &segment: m_Segments) {
+      count += segment.records.size();
+    }
+
+    return count;
+  }
+
+  void Rewind::StartSegment(Machine &machine) {
+    auto &segment = m_Segments.emplace_back();
+    auto &keyframe = segment.keyframe;
+
+    machine.Capture(keyframe);
+
+    Entry record{};
+    record.cpu = keyframe.cpu;
+    record.stackSize = static_cast<uint16_t>(std::min(keyframe.stack.size(), Memory::StackLimit));
+    record.planeMask = keyframe.planeMask;
+    record.displayHighRes = keyframe.displayHighRes;
+    record.displayLoresGrid = keyframe.displayLoresGrid;
+    record.useBeep = keyframe.useBeep;
+    std::copy_n(keyframe.audioPattern.begin(), 16, record.audioPattern);
+
+    segment.records.push_back(record);
+
+    segment.bytes = sizeof(Segment) + sizeof(Entry) +
+                    keyframe.ram.size() +
+                    keyframe.stack.size() * sizeof(uint16_t) +
+                    keyframe.audioPattern.size() +
+                    sizeof(keyframe.planes);
+
+    m_Bytes += segment.bytes;
+
+    m_ShadowRam = keyframe.ram;
+    m_ShadowPlanes = keyframe.planes;
+  }
+
+  void Rewind::Rebuild(const Segment &segment, size_t index) {
+    const auto &keyframe = segment.keyframe;
+    const auto &data = segment.data;
+
+    m_Scratch.ram = keyframe.ram;
+    m_Scratch.planes = keyframe.planes;
+    m_Scratch.stack = keyframe.stack;
+
+    size_t pos = 0;
+
+    for (size_t n = 1; n <= index; n++) {
+      const auto &record = segment.records[n];
+      pos = record.offset;
+
+      for (uint16_t page = 0; page < record.pages; page++) {
+        uint32_t addr = data[pos++] << 8;
+
+        std::copy_n(data.begin() + static_cast<ptrdiff_t>(pos), PageSize, m_Scratch.ram.begin() + addr);
+        pos += PageSize;
+      }
+
+      for (uint16_t row = 0; row < record.rows; row++) {
+        auto plane = data[pos++];
+        auto from = data[pos++] * 2;
+
+        memcpy(&m_Scratch.planes[plane][from], &data[pos], RowBytes);
+        pos += RowBytes;
+      }
+
+      // Only the stack of the record being rebuilt matters
+      if (n == index) {
+        m_Scratch.stack.resize(record.stackSize);
+
+        for (auto &entry: m_Scratch.stack) {
+          entry = data[pos] | (data[pos + 1] << 8);
+          pos += 2;
+        }
+      }
+    }
+
+    const auto &record = segment.records[index];
+
+    m_Scratch.cpu = record.cpu;
+    m_Scratch.random = keyframe.random;
+    m_Scratch.random.discard(record.cpu.randomDraws - keyframe.cpu.randomDraws);
+
+    m_Scratch.audioPattern.assign(record.audioPattern, record.audioPattern + 16);
+    m_Scratch.useBeep = record.useBeep;
+    m_Scratch.planeMask = record.planeMask;
+    m_Scratch.displayHighRes = record.displayHighRes;
+    m_Scratch.displayLoresGrid = record.displayLoresGrid;
+  }
+
+  void Rewind::RestoreTo(Machine &machine, size_t segment, size_t index) {
+    auto &cpu = machine.GetCpu();
+    auto &target = m_Segments[segment];
+
+    Rebuild(target, index);
+
+    // Quirks are settings rather than state, going back shouldn't undo a change to them
+    auto current = cpu.GetState();
+    std::copy_n(current.regs.quirks, 8, m_Scratch.cpu.regs.quirks);
+
+    machine.Restore(m_Scratch);
+
+    // Whatever came after is a future that no longer happens
+    if (index + 1 < target.records.size()) {
+      auto end = target.records[index + 1].offset;
+      auto dropped = (target.records.size() - index - 1) * sizeof(Entry) + (target.data.size() - end);
+
+      target.records.resize(index + 1);
+      target.data.resize(end);
+      target.bytes -= dropped;
+      m_Bytes -= dropped;
+    }
+
+    while (m_Segments.size() > segment + 1) {
+      m_Bytes -= m_Segments.back().bytes;
+      m_Segments.pop_back();
+    }
+
+    m_ShadowRam = m_Scratch.ram;
+    m_ShadowPlanes = m_Scratch.planes;
+  }
+
+  void Rewind::Trim() {
+    while (m_Bytes > m_Budget && m_Segments.size() > 1) {
+      m_Bytes -= m_Segments.front().bytes;
+      m_Segments.pop_front();
+    }
+  }
+
+} // dorito
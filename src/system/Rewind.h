@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Machine.h"
+
+namespace dorito {
+
+  /* History of the machine for stepping and rewinding backwards.
+   *
+   * Every so many records a full keyframe is taken, the records in
+   * between only hold the CPU state plus the RAM pages and display rows
+   * that changed since the one before. Getting back to any record is a
+   * keyframe restore and a few deltas applied on top, getting back to a
+   * single instruction is that followed by replaying the rest of its
+   * frame. Whole keyframe segments are dropped oldest first to stay in
+   * the memory budget.
+   */
+  class Rewind {
+  public:
+    static constexpr uint32_t DefaultKeyframeInterval = 60;
+    static constexpr size_t DefaultBudget = 64 * 1024 * 1024;
+
+  public:
+    explicit Rewind(uint32_t keyframeInterval = DefaultKeyframeInterval, size_t budget = DefaultBudget);
+
+    // Once after every frame or single step that changed the machine
+    void Record(Machine &machine);
+
+    // Back to the start of the current frame, or to the one before when already there
+    bool FrameBack(Machine &machine);
+
+    // Back exactly one instruction
+    bool StepBack(Machine &machine);
+
+    void Clear();
+
+    [[nodiscard]] size_t Records() const;
+
+    [[nodiscard]] size_t Bytes() const { return m_Bytes; }
+
+  private:
+    struct Entry {
+      Chip8::State cpu{};
+
+      // Where this record's changes start in its segment's data
+      uint32_t offset = 0;
+      uint16_t pages = 0;
+      uint16_t rows = 0;
+      uint16_t stackSize = 0;
+
+      uint8_t planeMask = 0x1;
+      bool displayHighRes = false;
+      bool displayLoresGrid = true;
+      bool useBeep = true;
+      uint8_t audioPattern[16]{};
+    };
+
+    struct Segment {
+      Machine::Snapshot keyframe{};
+
+      // The first record is the keyframe itself and carries no changes
+      std::vector<Entry> records{};
+      std::vector<uint8_t> data{};
+
+      // Everything above, counted towards the budget
+      size_t bytes = 0;
+    };
+
+  private:
+    void StartSegment(Machine &machine);
+
+    // Rebuilds the state at records[index] of segment into m_Scratch
+    void Rebuild(const Segment &segment, size_t index);
+
+    // Restores records[index] of the segment and forgets everything after it
+    void RestoreTo(Machine &machine, size_t segment, size_t index);
+
+    void Trim();
+
+  private:
+    uint32_t m_KeyframeInterval;
+    size_t m_Budget;
+
+    std::deque<Segment> m_Segments;
+    size_t m_Bytes = 0;
+
+    // What the machine looked like at the last record, to find what changed since
+    std::vector<uint8_t> m_ShadowRam;
+    Display::Planes m_ShadowPlanes{};
+
+    Machine::Snapshot m_Scratch;
+  };
+
+} // dorito
@@ -0,0 +1,327 @@
+#include "SaveState.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+
+#include <fmt/format.h>
+
+namespace dorito {
+  namespace {
+    constexpr char Magic[4] = {'D', 'S', 'A', 'V'};
+    constexpr size_t HeaderSize = 20;
+    constexpr uint16_t Compressed = 0x1;
+
+    constexpr size_t RamSize = 0x10000;
+    constexpr size_t PlaneCount = 2;
+    constexpr size_t PlaneSize = sizeof(Display::Plane);
+
+    // Everything of a fixed size, copied as is
+    struct Fixed {
+      Chip8::State cpu;
+      std::mt19937 random;
+
+      uint32_t stackSize;
+      uint32_t audioSize;
+      uint32_t paletteSize;
+
+      uint8_t planeMask;
+      bool displayHighRes;
+      bool displayLoresGrid;
+      bool useBeep;
+    };
+
+    static_assert(std::is_trivially_copyable_v<Fixed>);
+    static_assert(std::is_standard_layout_v<Fixed>);
+
+    /* Only 0 and 1 are bools, anything else copied into one is undefined,
+     * so these bytes are looked at before the block is.
+     */
+    bool BoolsValid(const uint8_t *fixed) {
+      constexpr size_t cpu = offsetof(Fixed, cpu);
+      constexpr size_t regs = cpu + offsetof(Chip8::State, regs);
+
+      auto valid = [fixed](size_t offset, size_t count) {
+        return std::all_of(fixed + offset, fixed + offset + count, [](uint8_t byte) { return byte <= 1; });
+      };
+
+      return valid(regs + offsetof(Chip8::Registers, keys), sizeof(Chip8::Registers::keys)) &&
+             valid(regs + offsetof(Chip8::Registers, quirks), sizeof(Chip8::Registers::quirks)) &&
+             valid(cpu + offsetof(Chip8::State, waiting), 1) &&
+             valid(cpu + offsetof(Chip8::State, highRes), 1) &&
+             valid(cpu + offsetof(Chip8::State, pitchDirty), 1) &&
+             valid(offsetof(Fixed, displayHighRes), 1) &&
+             valid(offsetof(Fixed, displayLoresGrid), 1) &&
+             valid(offsetof(Fixed, useBeep), 1);
+    }
+
+    void Put16(std::vector<uint8_t> &out, uint16_t value) {
+      out.push_back(value & 0xFF);
+      out.push_back(value >> 8);
+    }
+
+    void Put32(std::vector<uint8_t> &out, uint32_t value) {
+      for (uint8_t n = 0; n < 4; n++) {
+        out.push_back((value >> (n * 8)) & 0xFF);
+      }
+    }
+
+    uint16_t Get16(const uint8_t *data) {
+      return data[0] | (data[1] << 8);
+    }
+
+    uint32_t Get32(const uint8_t *data) {
+      return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    void PutBytes(std::vector<uint8_t> &out, const void *data, size_t size) {
+      auto at = out.size();
+      out.resize(at + size);
+      memcpy(&out[at], data, size);
+    }
+
+    /* A control byte below 0x80 is followed by that many plus one literal
+     * bytes, from 0x80 up it is one byte repeated that many less 0x7D
+     * times, 3 to 130.
+     */
+    void Pack(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+      size_t pos = 0;
+      size_t literal = 0;
+
+      auto flush = [&](size_t end) {
+        while (literal < end) {
+          auto count = std::min<size_t>(end - literal, 0x80);
+          out.push_back(static_cast<uint8_t>(count - 1));
+          out.insert(out.end(), data + literal, data + literal + count);
+          literal += count;
+        }
+      };
+
+      while (pos < size) {
+        auto value = data[pos];
+        size_t run = 1;
+
+        while (pos + run < size && run < 130 && data[pos + run] == value) {
+          run++;
+        }
+
+        if (run < 3) {
+          pos += run;
+          continue;
+        }
+
+        flush(pos);
+
+        out.push_back(static_cast<uint8_t>(run + 0x7D));
+        out.push_back(value);
+
+        pos += run;
+        literal = pos;
+      }
+
+      flush(size);
+    }
+
+    bool Unpack(const uint8_t *data, size_t size, std::vector<uint8_t> &out, size_t expected) {
+      out.resize(expected);
+
+      size_t in = 0;
+      size_t at = 0;
+
+      while (in < size) {
+        auto control = data[in++];
+
+        if (control < 0x80) {
+          size_t count = control + 1;
+
+          if (in + count > size || at + count > expected)
+            return false;
+
+          memcpy(&out[at], data + in, count);
+          in += count;
+          at += count;
+        } else {
+          size_t count = control - 0x7D;
+
+          if (in >= size || at + count > expected)
+            return false;
+
+          memset(&out[at], data[in++], count);
+          at += count;
+        }
+      }
+
+      return at == expected;
+    }
+  }
+
+  void SaveState::Serialize(std::vector<uint8_t> &out, bool compress) const {
+    const auto &s = snapshot;
+
+    Fixed fixed{};
+    fixed.cpu = s.cpu;
+    fixed.random = s.random;
+    fixed.stackSize = static_cast<uint32_t>(s.stack.size());
+    fixed.audioSize = static_cast<uint32_t>(s.audioPattern.size());
+    fixed.paletteSize = static_cast<uint32_t>(palette.size());
+    fixed.planeMask = s.planeMask;
+    fixed.displayHighRes = s.displayHighRes;
+    fixed.displayLoresGrid = s.displayLoresGrid;
+    fixed.useBeep = s.useBeep;
+
+    std::vector<uint8_t> body;
+    body.reserve(sizeof(Fixed) + RamSize + PlaneCount * PlaneSize + 1024);
+
+    PutBytes(body, &fixed, sizeof(Fixed));
+    PutBytes(body, s.ram.data(), s.ram.size());
+    PutBytes(body, s.stack.data(), s.stack.size() * sizeof(uint16_t));
+    PutBytes(body, s.audioPattern.data(), s.audioPattern.size());
+
+    for (const auto &plane: s.planes) {
+      PutBytes(body, plane.data(), PlaneSize);
+    }
+
+    PutBytes(body, palette.data(), palette.size() * sizeof(uint32_t));
+
+    out.clear();
+    PutBytes(out, Magic, sizeof(Magic));
+    Put16(out, Version);
+    Put16(out, compress ? Compressed : 0);
+    Put16(out, static_cast<uint16_t>(sizeof(Fixed)));
+    Put16(out, 0);
+    Put32(out, static_cast<uint32_t>(body.size()));
+
+    if (!compress) {
+      Put32(out, static_cast<uint32_t>(body.size()));
+      out.insert(out.end(), body.begin(), body.end());
+      return;
+    }
+
+    Put32(out, 0);
+    Pack(body.data(), body.size(), out);
+
+    auto stored = static_cast<uint32_t>(out.size() - HeaderSize);
+    memcpy(&out[16], &stored, sizeof(stored));
+  }
+
+  std::string SaveState::Deserialize(const std::vector<uint8_t> &data) {
+    if (data.size() < HeaderSize || !std::equal(std::begin(Magic), std::end(Magic), data.begin()))
+      return "Not a save state";
+
+    if (Get16(&data[4]) != Version)
+      return "Save state is from an unknown version";
+
+    if (Get16(&data[8]) != sizeof(Fixed))
+      return "Save state is from a different build";
+
+    auto flags = Get16(&data[6]);
+    auto rawSize = Get32(&data[12]);
+    auto storedSize = Get32(&data[16]);
+
+    if (data.size() - HeaderSize != storedSize)
+      return "Save state is cut short";
+
+    std::vector<uint8_t> unpacked;
+    const uint8_t *body = &data[HeaderSize];
+
+    if (flags & Compressed) {
+      if (!Unpack(body, storedSize, unpacked, rawSize))
+        return "Save state is corrupt";
+
+      body = unpacked.data();
+    } else if (rawSize != storedSize) {
+      return "Save state is corrupt";
+    }
+
+    if (rawSize < sizeof(Fixed))
+      return "Save state is cut short";
+
+    if (!BoolsValid(body))
+      return "Save state is corrupt";
+
+    Fixed fixed{};
+    memcpy(&fixed, body, sizeof(Fixed));
+
+    // Everything below is used as a size or an index once it's in the machine
+    if (fixed.audioSize != Memory::AudioPatternSize ||
+        fixed.stackSize > Memory::StackLimit ||
+        fixed.planeMask > 0x3 ||
+        (fixed.paletteSize != 0 && fixed.paletteSize != PaletteSize) ||
+        fixed.cpu.keyPressRegister > 0xF ||
+        fixed.cpu.waitForInterrupt > 2)
+      return "Save state is corrupt";
+
+    size_t expected = sizeof(Fixed) + RamSize +
+                      size_t{fixed.stackSize} * sizeof(uint16_t) +
+                      fixed.audioSize +
+                      PlaneCount * PlaneSize +
+                      size_t{fixed.paletteSize} * sizeof(uint32_t);
+
+    if (rawSize != expected)
+      return "Save state doesn't match this machine";
+
+    auto &s = snapshot;
+    const uint8_t *at = body + sizeof(Fixed);
+
+    auto take = [&at](void *to, size_t size) {
+      memcpy(to, at, size);
+      at += size;
+    };
+
+    s.cpu = fixed.cpu;
+    s.random = fixed.random;
+    s.planeMask = fixed.planeMask;
+    s.displayHighRes = fixed.displayHighRes;
+    s.displayLoresGrid = fixed.displayLoresGrid;
+    s.useBeep = fixed.useBeep;
+
+    s.ram.resize(RamSize);
+    take(s.ram.data(), RamSize);
+
+    s.stack.resize(fixed.stackSize);
+    take(s.stack.data(), s.stack.size() * sizeof(uint16_t));
+
+    s.audioPattern.resize(fixed.audioSize);
+    take(s.audioPattern.data(), s.audioPattern.size());
+
+    for (auto &plane: s.planes) {
+      take(plane.data(), PlaneSize);
+    }
+
+    palette.resize(fixed.paletteSize);
+    take(palette.data(), palette.size() * sizeof(uint32_t));
+
+    return {};
+  }
+
+  std::string SaveState::Save(const std::string &path, bool compress) const {
+    std::vector<uint8_t> out;
+    Serialize(out, compress);
+
+    std::ofstream stream(path, std::ios::binary);
+
+    if (!stream.good())
+      return fmt::format("Couldn't open {} for writing", path);
+
+    stream.write(reinterpret_cast<const char *>(out.data()), static_cast<std::streamsize>(out.size()));
+
+    return stream.good() ? std::string{} : fmt::format("Couldn't write {}", path);
+  }
+
+  std::string SaveState::Load(const std::string &path) {
+    std::ifstream stream(path, std::ios::binary);
+
+    if (!stream.good())
+      return fmt::format("Couldn't open {}", path);
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    auto error = Deserialize(data);
+
+    return error.empty() ? error : fmt::format("{}: {}", path, error);
+  }
+
+} // dorito
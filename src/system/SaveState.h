@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Machine.h"
+
+namespace dorito {
+
+  /* The whole machine plus the palette it was shown with, as bytes.
+   *
+   * A short header is followed by one fixed block copied straight out of
+   * memory, CPU state and random engine included, then RAM, stack, audio
+   * pattern, display planes and palette as plain arrays. The fixed block
+   * is only readable by a build with the same layout, the header records
+   * its size so anything else is refused rather than misread. The body
+   * can be run length encoded, which mostly empty RAM and screens shrink
+   * well under.
+   */
+  class SaveState {
+  public:
+    static constexpr uint16_t Version = 3;
+    static constexpr size_t PaletteSize = 4;
+
+  public:
+    Machine::Snapshot snapshot{};
+
+    // 0xRRGGBBAA, one per combination of the two planes, or empty
+    std::vector<uint32_t> palette{};
+
+  public:
+    void Serialize(std::vector<uint8_t> &out, bool compress = true) const;
+
+    // Returns an empty string on success, leaves the state alone otherwise
+    std::string Deserialize(const std::vector<uint8_t> &data);
+
+    [[nodiscard]] std::string Save(const std::string &path, bool compress = true) const;
+
+    std::string Load(const std::string &path);
+  };
+
+} // dorito
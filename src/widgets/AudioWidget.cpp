@@ -5,8 +5,8 @@
 namespace dorito {
   void AudioWidget::Draw() {
     auto &bus = Bus::Get();
-    auto &cpu = bus.GetCpu();
-    auto &buffer = bus.GetRam().GetAudioBuffer();
+    const auto &frame = bus.LatestFrame();
+    const auto &buffer = frame.audioPattern;
 
     bool wasEnabled = m_Enabled;
 
@@ -22,14 +22,14 @@ namespace dorito {
       ImGui::TableNextRow();
 
       ImGui::TableSetColumnIndex(0);
-      ImGui::Text("%gHz", cpu.regs.pitch);
+      ImGui::Text("%gHz", frame.pitch);
 
       ImGui::EndTable();
 
       ImGui::Separator();
 
       ImGui::BeginTable("audiobuffer", 1, ImGuiTableFlags_RowBg);
-      ImGui::TableSetupColumn("Audio Buffer", ImGuiTableColumnFlags_None);
+      ImGui::TableSetupColumn(frame.useBeep ? "Audio Buffer (beep)" : "Audio Buffer", ImGuiTableColumnFlags_None);
 
       ImGui::TableHeadersRow();
       ImGui::TableNextRow();
@@ -47,7 +47,7 @@ namespace dorito {
 
       ImGui::Separator();
 
-      auto patternToBits = [](const std::vector<uint8_t> &pattern) {
+      auto patternToBits = [](const auto &pattern) {
         std::vector<float> bits = std::vector<float>(512);
         auto i = 0;
 
@@ -6,7 +6,6 @@ namespace dorito {
   void BreakpointsWidget::Draw() {
     auto &bus = Bus::Get();
     auto &cpu = bus.GetCpu();
-    auto &breakpoints = cpu.Breakpoints();
 
     bool wasEnabled = m_Enabled;
 
@@ -15,39 +14,92 @@ namespace dorito {
     if (!ImGui::Begin(ICON_FA_CIRCLE " Breakpoints", &m_Enabled)) {
       ImGui::End();
     } else {
-      ImGui::BeginTable("breakpoints", 4, ImGuiTableFlags_RowBg);
+      // Drawn from a copy, changes are made by label under the lock
+      auto lock = bus.Lock();
+      auto breakpoints = cpu.Breakpoints();
+      lock.unlock();
+
+      ImGui::BeginTable("breakpoints", 6, ImGuiTableFlags_RowBg);
       ImGui::TableSetupColumn("##1", ImGuiTableColumnFlags_WidthFixed, 30.0f);
       ImGui::TableSetupColumn("Name##2", ImGuiTableColumnFlags_WidthFixed, 50.0f);
-      ImGui::TableSetupColumn("Address##3", ImGuiTableColumnFlags_WidthStretch);
-      ImGui::TableSetupColumn("##4", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+      ImGui::TableSetupColumn("Address##3", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+      ImGui::TableSetupColumn("Condition##4", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("Hits / Stop At##5", ImGuiTableColumnFlags_WidthFixed, 110.0f);
+      ImGui::TableSetupColumn("##6", ImGuiTableColumnFlags_WidthFixed, 60.0f);
       ImGui::TableHeadersRow();
 
       int32_t count = 0;
       for (const auto &bp: breakpoints) {
-        auto checkId = fmt::format("##{}", count++);
+        ImGui::PushID(count++);
+
         bool enabled = bp.enabled;
         ImGui::TableNextRow();
 
         ImGui::TableSetColumnIndex(0);
-        if (ImGui::Checkbox(checkId.c_str(), &enabled)) {
+        if (ImGui::Checkbox("##enabled", &enabled)) {
+          lock = bus.Lock();
           cpu.ToggleBreakpoint(bp);
+          lock.unlock();
         }
 
         ImGui::TableSetColumnIndex(1);
         ImGui::Text("%s", bp.label.c_str());
 
         ImGui::TableSetColumnIndex(2);
-        ImGui::Text("%s", fmt::format("0x{:04X}", bp.addr).c_str());
+        ImGui::Text("0x%04X", bp.addr);
 
         ImGui::TableSetColumnIndex(3);
+        auto [condition, added] = m_Conditions.try_emplace(bp.label);
+        if (added) {
+          bp.condition.copy(condition->second.data(), condition->second.size() - 1);
+        }
+
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        if (ImGui::InputTextWithHint("##condition", "v3 == 0x10 && i > 0x400",
+                                     condition->second.data(), condition->second.size(),
+                                     ImGuiInputTextFlags_EnterReturnsTrue)) {
+          lock = bus.Lock();
+          m_Errors[bp.label] = cpu.SetBreakpointCondition(bp, condition->second.data(), bp.hitTarget);
+          lock.unlock();
+        }
+
+        const auto &error = m_Errors[bp.label];
+        if (!error.empty()) {
+          ImGui::TextColored({1.0f, 0.4f, 0.4f, 1.0f}, "%s", error.c_str());
+        }
+
+        ImGui::TableSetColumnIndex(4);
+        ImGui::Text("%u /", bp.hits);
+        ImGui::SameLine();
+
+        uint32_t hitTarget = bp.hitTarget;
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        if (ImGui::InputScalar("##target", ImGuiDataType_U32, &hitTarget)) {
+          lock = bus.Lock();
+          cpu.SetBreakpointCondition(bp, bp.condition, hitTarget);
+          lock.unlock();
+        }
+
+        ImGui::TableSetColumnIndex(5);
         if (ImGui::Button("Remove")) {
+          m_Conditions.erase(bp.label);
+          m_Errors.erase(bp.label);
+
+          lock = bus.Lock();
           cpu.RemoveBreakpoint(bp);
+          lock.unlock();
+
+          ImGui::PopID();
           break;
         }
+
+        ImGui::PopID();
       }
 
       ImGui::EndTable();
 
+      DrawWatchpoints();
+
       if (!m_Enabled && wasEnabled) {
         EventManager::Dispatcher().enqueue<Events::SaveAppPrefs>();
       }
@@ -55,4 +107,114 @@ namespace dorito {
       ImGui::End();
     }
   }
+
+  void BreakpointsWidget::DrawWatchpoints() {
+    auto &bus = Bus::Get();
+    auto &watchpoints = bus.GetRam().GetWatchpoints();
+
+    ImGui::Separator();
+    ImGui::Text(ICON_FA_EYE " Watchpoints");
+
+    // Add row, the address is ignored for the 16 byte audio pattern buffer
+    ImGui::Checkbox("Audio", &m_WatchAudio);
+    ImGui::SameLine();
+
+    ImGui::BeginDisabled(m_WatchAudio);
+    ImGui::SetNextItemWidth(60.0f);
+    ImGui::InputScalar("Addr", ImGuiDataType_U16, &m_WatchAddr, nullptr, nullptr, "%04X",
+                       ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(50.0f);
+    ImGui::InputScalar("Len", ImGuiDataType_U16, &m_WatchLength);
+    ImGui::EndDisabled();
+
+    ImGui::SameLine();
+    ImGui::Checkbox("R", &m_WatchRead);
+    ImGui::SameLine();
+    ImGui::Checkbox("W", &m_WatchWrite);
+    ImGui::SameLine();
+    ImGui::Checkbox("Changed", &m_WatchChange);
+    ImGui::SameLine();
+
+    uint8_t access = (m_WatchRead ? Watchpoint::Read : 0) |
+                     (m_WatchWrite ? Watchpoint::Write : 0) |
+                     (m_WatchChange ? Watchpoint::Change : 0);
+
+    ImGui::BeginDisabled(access == 0 || (!m_WatchAudio && m_WatchLength == 0));
+    if (ImGui::Button("Add")) {
+      Watchpoint watchpoint{
+          fmt::format("w{}", ++m_WatchCount),
+          m_WatchAudio ? Watchpoint::Space::Audio : Watchpoint::Space::Ram,
+          m_WatchAudio ? uint16_t{0} : m_WatchAddr,
+          m_WatchAudio ? uint16_t{16} : m_WatchLength,
+          access,
+          true
+      };
+
+      auto lock = bus.Lock();
+      watchpoints.Add(watchpoint);
+    }
+    ImGui::EndDisabled();
+
+    ImGui::BeginTable("watchpoints", 6, ImGuiTableFlags_RowBg);
+    ImGui::TableSetupColumn("##1", ImGuiTableColumnFlags_WidthFixed, 30.0f);
+    ImGui::TableSetupColumn("Name##2", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+    ImGui::TableSetupColumn("Range##3", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("On##4", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+    ImGui::TableSetupColumn("Hits##5", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+    ImGui::TableSetupColumn("##6", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+    ImGui::TableHeadersRow();
+
+    auto lock = bus.Lock();
+    auto list = watchpoints.List();
+    lock.unlock();
+
+    int32_t count = 0;
+    for (const auto &wp: list) {
+      ImGui::PushID(count++);
+
+      bool enabled = wp.enabled;
+      ImGui::TableNextRow();
+
+      ImGui::TableSetColumnIndex(0);
+      if (ImGui::Checkbox("##enabled", &enabled)) {
+        lock = bus.Lock();
+        watchpoints.Toggle(wp.label);
+        lock.unlock();
+      }
+
+      ImGui::TableSetColumnIndex(1);
+      ImGui::Text("%s", wp.label.c_str());
+
+      ImGui::TableSetColumnIndex(2);
+      if (wp.space == Watchpoint::Space::Audio) {
+        ImGui::Text("Audio pattern");
+      } else {
+        ImGui::Text("0x%04X - 0x%04X", wp.addr, wp.addr + wp.length - 1);
+      }
+
+      ImGui::TableSetColumnIndex(3);
+      ImGui::Text("%s%s%s",
+                  wp.access & Watchpoint::Read ? "R" : "",
+                  wp.access & Watchpoint::Write ? "W" : "",
+                  wp.access & Watchpoint::Change ? "C" : "");
+
+      ImGui::TableSetColumnIndex(4);
+      ImGui::Text("%u", wp.hits);
+
+      ImGui::TableSetColumnIndex(5);
+      if (ImGui::Button("Remove")) {
+        lock = bus.Lock();
+        watchpoints.Remove(wp.label);
+        lock.unlock();
+
+        ImGui::PopID();
+        break;
+      }
+
+      ImGui::PopID();
+    }
+
+    ImGui::EndTable();
+  }
 } // dorito
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <unordered_map>
+
 #include "Widget.h"
 
 namespace dorito {
@@ -11,6 +14,23 @@ namespace dorito {
     }
 
     void Draw() override;
+
+  private:
+    void DrawWatchpoints();
+
+  private:
+    // Condition being typed for each breakpoint label, and why the last one didn't compile
+    std::unordered_map<std::string, std::array<char, 128>> m_Conditions;
+    std::unordered_map<std::string, std::string> m_Errors;
+
+    // The watchpoint being set up in the add row
+    uint16_t m_WatchAddr = 0x200;
+    uint16_t m_WatchLength = 1;
+    bool m_WatchRead = false;
+    bool m_WatchWrite = true;
+    bool m_WatchChange = false;
+    bool m_WatchAudio = false;
+    uint32_t m_WatchCount = 0;
   };
 
 } // dorito
@@ -13,7 +13,7 @@ namespace dorito {
     ImVec2 center = ImGui::GetMainViewport()->GetCenter();
     ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
 
-    auto &palette = bus.GetDisplay().Palette();
+    auto &palette = bus.Palette();
 
     auto colorToImvec = [](const Color &color) {
       return ImVec4{
@@ -3,6 +3,15 @@
 #include "layers/UI.h"
 
 namespace dorito {
+  void DisassemblyWidget::Enabled(bool isEnabled) {
+    m_Enabled = isEnabled;
+
+    // Nothing is disassembled while the window is closed
+    auto &bus = Bus::Get();
+    auto lock = bus.Lock();
+    bus.GetCpu().DisassemblyEnabled(isEnabled);
+  }
+
   void DisassemblyWidget::Draw() {
     auto &bus = Bus::Get();
     auto &cpu = bus.GetCpu();
@@ -19,70 +28,80 @@ namespace dorito {
                                        ImGuiTableFlags_BordersOuterH |
                                        ImGuiTableFlags_BordersOuterV |
                                        ImGuiTableFlags_RowBg)) {
-        auto &lines = cpu.m_Disassembly;
+        // Only what is on screen gets copied out, a few rows at a time under the lock
+        auto lock = bus.Lock();
+        cpu.UpdateDisassembly();
+
+        auto lineCount = cpu.Disassembly().size();
+        auto prevPC = cpu.m_PrevPC;
+        auto prevRow = prevPC != UI::PrevPC ? cpu.DisassemblyRow(prevPC) : -1;
+
+        // Rows warm up with how often they ran while the profiler records
+        const auto &profiler = cpu.GetProfiler();
+        auto hottest = profiler.Enabled() ? profiler.Hottest() : 0;
+        lock.unlock();
 
         ImGui::TableSetupColumn("Address", ImGuiTableColumnFlags_WidthFixed, 50.0f);
         ImGui::TableSetupColumn("Bytes", ImGuiTableColumnFlags_WidthFixed, 90.0f);
         ImGui::TableSetupColumn("Instruction", ImGuiTableColumnFlags_WidthStretch);
 
         ImGuiListClipper clipper;
-        size_t lineSize = lines.size();
-        clipper.Begin((int) lineSize);
-
-        auto lineByIndex = [lines](int index) -> Chip8::DisassemblyLine {
-          for (const auto &[_, line]: lines) {
-            if (line.index == index)
-              return line;
-          }
-
-          return Chip8::DisassemblyLine{
-              0xFFFF,
-              0xFFFF,
-              "",
-              ""
-          };
-        };
+        clipper.Begin((int) lineCount);
 
-        bool lineHighlite = false;
+        std::vector<Chip8::DisassemblyLine> visible;
+        std::vector<float> heats;
 
         while (clipper.Step()) {
-          for (auto item = clipper.DisplayStart; item < clipper.DisplayEnd; item++) {
-            auto line = lineByIndex(item);
+          visible.clear();
+          heats.clear();
 
-            if (line.index == 0xFFFF)
+          lock = bus.Lock();
+          const auto &lines = cpu.Disassembly();
+
+          for (auto row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            // A reset may have emptied the list since, those rows go blank for a draw
+            if (row >= (int) lines.size()) {
+              visible.emplace_back();
+              heats.push_back(0.0f);
               continue;
+            }
+
+            visible.push_back(lines[row]);
+            heats.push_back(Profiler::Heat(profiler.At(lines[row].addr), hottest));
+          }
+
+          lock.unlock();
+
+          for (size_t n = 0; n < visible.size(); n++) {
+            const auto &line = visible[n];
 
             ImGui::TableNextRow();
 
-            if (!lineHighlite && (line.index == lines.size() - 1 ||
-                                  line.addr == cpu.m_PrevPC)) {
+            if (line.addr == prevPC) {
               ImU32 row_bg_color = ImGui::GetColorU32(ImVec4(0.18f, 0.47f, 0.59f, 0.65f));
               ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg1, row_bg_color);
-              lineHighlite = true;
+            } else if (auto heat = heats[n]; heat > 0.0f) {
+              ImU32 heat_color = ImGui::GetColorU32(ImVec4(0.85f, 0.25f * (1.0f - heat), 0.05f, 0.15f + 0.5f * heat));
+              ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg1, heat_color);
             }
 
             ImGui::TableSetColumnIndex(0);
-            ImGui::TextUnformatted(fmt::format("${:04X}", line.addr).c_str());
+            ImGui::Text("$%04X", line.addr);
 
             ImGui::TableSetColumnIndex(1);
-            ImGui::TextUnformatted(fmt::format("{}", line.bytes).c_str());
+            ImGui::TextUnformatted(line.bytes.c_str());
 
             ImGui::TableSetColumnIndex(2);
             ImGui::TextUnformatted(line.text.c_str());
           }
         }
 
-        if (cpu.m_PrevPC != UI::PrevPC) {
-          auto addr = cpu.m_PrevPC;
-
-          if (lines.contains(addr)) {
-            auto size = ImGui::GetWindowSize();
-            auto &line = lines[addr];
-            ImGui::SetScrollY(
-                (clipper.ItemsHeight * (float) line.index - (size.y / 2) -
-                 (clipper.ItemsHeight / clipper.ItemsCount)));
-            UI::PrevPC = addr;
-          }
+        if (prevRow >= 0) {
+          auto size = ImGui::GetWindowSize();
+          ImGui::SetScrollY(
+              (clipper.ItemsHeight * (float) prevRow - (size.y / 2) -
+               (clipper.ItemsHeight / clipper.ItemsCount)));
+          UI::PrevPC = prevPC;
         }
 
         ImGui::EndTable();
@@ -90,6 +109,7 @@ namespace dorito {
       }
 
       if (!m_Enabled && wasEnabled) {
+        Enabled(false);
         EventManager::Dispatcher().enqueue<Events::SaveAppPrefs>();
       }
 
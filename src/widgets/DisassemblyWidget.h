@@ -11,6 +11,8 @@ namespace dorito {
     }
 
     void Draw() override;
+
+    void Enabled(bool isEnabled) override;
   };
 
 } // dorito
@@ -252,7 +252,12 @@ namespace dorito {
     auto &bus = Bus::Get();
     auto &cpu = bus.GetCpu();
 
+    // Conditions set in the Breakpoints window outlive a recompile
+    auto lock = bus.Lock();
+    auto previousBreakpoints = cpu.Breakpoints();
+
     cpu.ClearBreakpoints();
+    lock.unlock();
     DeleteProgram();
 
     auto code = m_Editor.getText();
@@ -281,6 +286,8 @@ namespace dorito {
       }
     }
 
+    lock = bus.Lock();
+
     for (uint16_t i = 0; i < 1024 * 64 - 1; i++) {
       if (!m_Program->breakpoints[i])
         continue;
@@ -289,6 +296,13 @@ namespace dorito {
       cpu.AddBreakpoint({label, i, true});
     }
 
+    for (const auto &bp: previousBreakpoints) {
+      if (!bp.condition.empty() || bp.hitTarget > 0)
+        cpu.SetBreakpointCondition(bp, bp.condition, bp.hitTarget);
+    }
+
+    lock.unlock();
+
     if (m_Program->is_error) {
       auto &editor = m_Editor.GetEditor();
       auto buffer = editor.GetActiveBuffer();
@@ -24,15 +24,16 @@ namespace dorito {
       m_CycleEntries[index++].set = (cycles == val);
     }
 
+    auto lock = bus.Lock();
     auto quirks = bus.Quirks();
+    auto profile = bus.GetCompatProfile();
+    lock.unlock();
 
     for (const auto &entry: m_QuirkEntries) {
       uint8_t quirkIndex = static_cast<uint8_t>(entry.quirk);
       SetQuirkEntry(quirkIndex, quirks[quirkIndex]);
     }
 
-    auto profile = bus.GetCompatProfile();
-
     m_ProfileEntries[0].set = profile == Bus::CompatProfile::VIP;
     m_ProfileEntries[1].set = profile == Bus::CompatProfile::SCHIP;
     m_ProfileEntries[2].set = profile == Bus::CompatProfile::XOChip;
@@ -40,6 +41,21 @@ namespace dorito {
     m_DoritoMuted = bus.Muted();
   }
 
+  void MainMenuWidget::DrawThroughput() {
+    auto &bus = Bus::Get();
+    const auto &frame = bus.LatestFrame();
+
+    if (!bus.MaxSpeed() && !bus.Running())
+      return;
+
+    auto text = fmt::format("{:.2f} MIPS  {:.0f} FPS",
+                            frame.instructionsPerSecond / 1000000.0,
+                            frame.framesPerSecond);
+
+    ImGui::SameLine(ImGui::GetWindowWidth() - ImGui::CalcTextSize(text.c_str()).x - 16.0f);
+    ImGui::TextUnformatted(text.c_str());
+  }
+
   void MainMenuWidget::DrawMenubar() {
     auto &bus = Bus::Get();
 
@@ -96,6 +112,34 @@ namespace dorito {
 
         ImGui::Separator();
 
+        if (ImGui::BeginMenu("Save State", !bus.Path().empty())) {
+          for (uint8_t slot = 1; slot <= Bus::StateSlots; slot++) {
+            auto label = fmt::format("Slot {}", slot);
+            auto shortcut = fmt::format("Shift+F{}", slot);
+
+            if (ImGui::MenuItem(label.c_str(), shortcut.c_str())) {
+              EventManager::Dispatcher().enqueue<Events::SaveStateSlot>({slot});
+            }
+          }
+
+          ImGui::EndMenu();
+        }
+
+        if (ImGui::BeginMenu("Load State", !bus.Path().empty())) {
+          for (uint8_t slot = 1; slot <= Bus::StateSlots; slot++) {
+            auto label = fmt::format("Slot {}", slot);
+            auto shortcut = fmt::format("F{}", slot);
+
+            if (ImGui::MenuItem(label.c_str(), shortcut.c_str())) {
+              EventManager::Dispatcher().enqueue<Events::LoadStateSlot>({slot});
+            }
+          }
+
+          ImGui::EndMenu();
+        }
+
+        ImGui::Separator();
+
         if (ImGui::MenuItem("Unload ROM")) {
           EventManager::Dispatcher().trigger<Events::UIResetPC>();
           EventManager::Dispatcher().trigger(Events::UnloadROM{});
@@ -140,6 +184,12 @@ namespace dorito {
               EventManager::Dispatcher().enqueue(Events::SavePrefs());
             }
           }
+
+          ImGui::Separator();
+
+          if (ImGui::MenuItem(ICON_FA_FORWARD " Max Speed", nullptr, bus.MaxSpeed())) {
+            EventManager::Dispatcher().enqueue<Events::SetMaxSpeed>({!bus.MaxSpeed()});
+          }
           ImGui::EndMenu();
         }
 
@@ -198,7 +248,7 @@ namespace dorito {
           ImGui::SameLine();
         };
 
-        auto &currentPalette = bus.GetDisplay().Palette();
+        auto &currentPalette = bus.Palette();
 
         if (ImGui::BeginMenu(ICON_FA_PALETTE " Colors")) {
           uint8_t index = 0;
@@ -264,6 +314,33 @@ namespace dorito {
           if (ImGui::MenuItem(ICON_FA_BARS " Disassembly", nullptr, status["Disassembly"])) {
             EventManager::Dispatcher().enqueue<Events::UIToggleEnabled>("Disassembly");
           }
+          if (ImGui::MenuItem(ICON_FA_LIST " Trace", nullptr, status["Trace"])) {
+            EventManager::Dispatcher().enqueue<Events::UIToggleEnabled>("Trace");
+          }
+          if (ImGui::MenuItem(ICON_FA_STOPWATCH " Profiler", nullptr, status["Profiler"])) {
+            EventManager::Dispatcher().enqueue<Events::UIToggleEnabled>("Profiler");
+          }
+
+          ImGui::Separator();
+
+          auto lock = bus.Lock();
+          bool threaded = bus.GetCpu().Threaded();
+          bool jit = bus.GetCpu().Jit();
+          bool jitChecked = bus.GetCpu().JitChecked();
+          lock.unlock();
+
+          if (ImGui::MenuItem("Threaded Interpreter", nullptr, threaded)) {
+            EventManager::Dispatcher().enqueue<Events::SetThreaded>({!threaded});
+          }
+
+          bool canRecompile = Chip8::JitAvailable() && threaded;
+
+          if (ImGui::MenuItem("Recompiler", nullptr, jit, canRecompile)) {
+            EventManager::Dispatcher().enqueue<Events::SetJit>({!jit});
+          }
+          if (ImGui::MenuItem("Check Recompiler", nullptr, jitChecked, canRecompile && jit)) {
+            EventManager::Dispatcher().enqueue<Events::SetJitChecked>({!jitChecked});
+          }
           ImGui::EndMenu();
         }
 
@@ -284,6 +361,9 @@ namespace dorito {
         }
         ImGui::EndMenu();
       }
+
+      DrawThroughput();
+
       ImGui::EndMenuBar();
     }
 
@@ -23,6 +23,8 @@ namespace dorito {
 
     void DrawMenubar();
 
+    void DrawThroughput();
+
   private:
     struct PaletteEntry {
       std::string name;
@@ -8,8 +8,48 @@ namespace dorito {
 
     if (m_Enabled) {
       static MemoryEditor memoryViewer;
+      memoryViewer.WriteFn = &MemoryEditorWidget::WriteByte;
+      memoryViewer.BgColorFn = &MemoryEditorWidget::HeatColor;
 
-      memoryViewer.DrawWindow(ICON_FA_MEMORY " Memory", &bus.GetRam().GetMemory()[0], 1024 * 64);
+      // The viewer draws and edits a copy, writes are passed on to the machine one by one
+      auto lock = bus.Lock();
+      const auto &profiler = bus.GetCpu().GetProfiler();
+      s_Hottest = profiler.Enabled() ? profiler.Hottest() : 0;
+
+      if (s_Hottest > 0)
+        s_Counts = profiler.Counts();
+
+      s_Ram = bus.GetRam().GetMemory();
+      lock.unlock();
+
+      memoryViewer.DrawWindow(ICON_FA_MEMORY " Memory", s_Ram.data(), 1024 * 64);
     }
   }
-} // dorito
\ No newline at end of file
+
+  ImU32 MemoryEditorWidget::HeatColor(const ImU8 *, size_t offset) {
+    if (s_Hottest == 0)
+      return 0;
+
+    // Both bytes of an instruction light up, counts are kept at its first
+    auto addr = static_cast<uint16_t>(offset);
+    auto count = std::max(s_Counts[addr], s_Counts[static_cast<uint16_t>(addr - 1)]);
+
+    auto heat = Profiler::Heat(count, s_Hottest);
+
+    if (heat <= 0.0f)
+      return 0;
+
+    return ImGui::GetColorU32(ImVec4(0.85f, 0.25f * (1.0f - heat), 0.05f, 0.15f + 0.5f * heat));
+  }
+
+  void MemoryEditorWidget::WriteByte(ImU8 *data, size_t offset, ImU8 value) {
+    data[offset] = value;
+
+    auto &bus = Bus::Get();
+    auto lock = bus.Lock();
+    bus.GetRam().GetMemory()[offset] = value;
+
+    // Edited bytes may be code we've already decoded
+    bus.GetCpu().InvalidateDecoded(offset);
+  }
+} // dorito
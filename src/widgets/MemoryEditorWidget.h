@@ -2,6 +2,8 @@
 
 #include "Widget.h"
 
+#include <vector>
+
 namespace dorito {
 
   class MemoryEditorWidget : public Widget {
@@ -11,6 +13,19 @@ namespace dorito {
     }
 
     void Draw() override;
+
+  private:
+    static void WriteByte(ImU8 *data, size_t offset, ImU8 value);
+
+    static ImU32 HeatColor(const ImU8 *data, size_t offset);
+
+  private:
+    // Taken once per draw rather than once per byte
+    static inline uint64_t s_Hottest = 0;
+
+    // The machine's memory and profile as of this draw
+    static inline std::vector<uint8_t> s_Ram;
+    static inline std::vector<uint64_t> s_Counts;
   };
 
 } // dorito
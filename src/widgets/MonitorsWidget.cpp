@@ -2,6 +2,7 @@
 
 #include "layers/UI.h"
 
+#include <algorithm>
 #include <regex>
 
 namespace dorito {
@@ -20,8 +21,6 @@ namespace dorito {
 
   void MonitorsWidget::Draw() {
     auto &bus = Bus::Get();
-    auto &cpu = bus.GetCpu();
-    auto &ram = bus.GetRam().GetMemory();
 
     bool wasEnabled = m_Enabled;
 
@@ -30,13 +29,23 @@ namespace dorito {
     if (!ImGui::Begin(ICON_FA_SEARCH " Monitors", &m_Enabled)) {
       ImGui::End();
     } else {
+      // Formatting happens on copies, the emulation thread only waits for these
+      auto lock = bus.Lock();
+      std::copy_n(bus.GetCpu().regs.v, m_Registers.size(), m_Registers.begin());
+      m_Ram = bus.GetRam().GetMemory();
+      lock.unlock();
 
-      ImGui::BeginTable("monitors", 2, ImGuiTableFlags_RowBg);
+      const auto &ram = m_Ram;
+
+      ImGui::BeginTable("monitors", 3, ImGuiTableFlags_RowBg);
       ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthFixed, 100.0f);
       ImGui::TableSetupColumn("Value", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("Watch", ImGuiTableColumnFlags_WidthFixed, 40.0f);
       ImGui::TableHeadersRow();
 
-      for (const auto &item: m_Monitors) {
+      int32_t count = 0;
+      for (auto &item: m_Monitors) {
+        ImGui::PushID(count++);
         ImGui::TableNextRow();
 
         switch (item.type) {
@@ -53,7 +62,7 @@ namespace dorito {
               if (i > 0 && i % 4 == 0)
                 values += "\n";
 
-              values += fmt::format("0x{:02X} ", cpu.regs.v[i]);
+              values += fmt::format("0x{:02X} ", m_Registers[i]);
             }
 
             ImGui::Text("%s", values.c_str());
@@ -66,11 +75,19 @@ namespace dorito {
             ImGui::TableSetColumnIndex(0);
             ImGui::Text("%s", name.c_str());
 
+            ImGui::TableSetColumnIndex(2);
+            bool watched = item.watched;
+            ImGui::BeginDisabled(ByteCount(item) == 0);
+            if (ImGui::Checkbox("##watch", &watched)) {
+              Watch(item, watched);
+            }
+            ImGui::EndDisabled();
+
             ImGui::TableSetColumnIndex(1);
 
             if (item.length == -1 && item.format.size() == 0) {
               ImGui::Text("<Invalid>");
-              continue;
+              break;
             }
 
             if (item.format.size() == 0) {
@@ -89,6 +106,8 @@ namespace dorito {
           }
             break;
         }
+
+        ImGui::PopID();
       }
 
       ImGui::EndTable();
@@ -101,7 +120,59 @@ namespace dorito {
     }
   }
 
+  uint32_t MonitorsWidget::ByteCount(const MonitorItem &item) {
+    if (item.type != Type::Memory)
+      return 0;
+
+    if (item.format.empty())
+      return item.length < 0 ? 0 : static_cast<uint32_t>(item.length) + 1;
+
+    // Same specifiers ParseFormat reads, each taking its count or one byte
+    std::regex formatPattern{"%([0-9]+)?[bBiIxXcC]"};
+    uint32_t count = 0;
+
+    for (std::sregex_iterator iter{item.format.begin(), item.format.end(), formatPattern}, end; iter != end; ++iter) {
+      count += (*iter)[1].matched ? std::stoi((*iter)[1].str()) : 1;
+    }
+
+    return count;
+  }
+
+  std::string MonitorsWidget::WatchLabel(const MonitorItem &item) {
+    return fmt::format("monitor {}", item.name);
+  }
+
+  void MonitorsWidget::Watch(MonitorItem &item, bool isWatched) {
+    auto &bus = Bus::Get();
+    auto lock = bus.Lock();
+    auto &watchpoints = bus.GetRam().GetWatchpoints();
+
+    item.watched = isWatched;
+
+    if (!isWatched) {
+      watchpoints.Remove(WatchLabel(item));
+      return;
+    }
+
+    auto length = std::min<uint32_t>(ByteCount(item), 0x10000 - item.base);
+
+    watchpoints.Add({
+        WatchLabel(item),
+        Watchpoint::Space::Ram,
+        static_cast<uint16_t>(item.base),
+        static_cast<uint16_t>(length),
+        Watchpoint::Change,
+        true
+    });
+  }
+
   void MonitorsWidget::HandleClearMonitors(const Events::UIClearMonitors &) {
+    // Recompiling drops the monitors, so drop what they were watching too
+    for (auto &item: m_Monitors) {
+      if (item.watched)
+        Watch(item, false);
+    }
+
     m_Monitors.clear();
   }
 
@@ -118,8 +189,7 @@ namespace dorito {
   }
 
   std::string MonitorsWidget::ParseFormat(const MonitorsWidget::MonitorItem &item) {
-    auto &bus = Bus::Get();
-    auto &ram = bus.GetRam().GetMemory();
+    const auto &ram = m_Ram;
 
     std::string format = item.format;
     std::regex formatPattern{"%([0-9]+)?([bBiIxXcC]){1}"};
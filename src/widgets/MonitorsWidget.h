@@ -2,6 +2,7 @@
 
 #include "Widget.h"
 
+#include <array>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -30,6 +31,9 @@ namespace dorito {
       int32_t length;
       std::string format;
       std::string name;
+
+      // Stops emulation when any byte shown here changes
+      bool watched = false;
     };
 
   private:
@@ -41,6 +45,13 @@ namespace dorito {
   private:
     std::string ParseFormat(const MonitorItem &item);
 
+    // How many bytes a memory monitor shows, 0 when it can't be read
+    static uint32_t ByteCount(const MonitorItem &item);
+
+    static std::string WatchLabel(const MonitorItem &item);
+
+    void Watch(MonitorItem &item, bool isWatched);
+
   private:
     void HandleClearMonitors(const Events::UIClearMonitors &event);
 
@@ -48,6 +59,10 @@ namespace dorito {
 
   private:
     std::vector<MonitorItem> m_Monitors;
+
+    // What the machine held when this frame's drawing started
+    std::array<uint8_t, 16> m_Registers{};
+    std::vector<uint8_t> m_Ram;
   };
 
 } // dorito
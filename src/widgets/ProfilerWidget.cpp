@@ -0,0 +1,290 @@
+#include "ProfilerWidget.h"
+
+#include <nfd.h>
+
+#include "layers/UI.h"
+
+namespace dorito {
+  void ProfilerWidget::Draw() {
+    auto &bus = Bus::Get();
+    auto &cpu = bus.GetCpu();
+
+    bool wasEnabled = m_Enabled;
+
+    ImGui::SetNextWindowSize({500, 450}, ImGuiCond_FirstUseEver);
+
+    if (!ImGui::Begin(ICON_FA_STOPWATCH " Profiler", &m_Enabled)) {
+      ImGui::End();
+    } else {
+      DrawToolbar(cpu);
+
+      // Figures for this draw, taken together so they agree with each other
+      auto lock = bus.Lock();
+      const auto &profiler = cpu.GetProfiler();
+      m_Frames = profiler.Frames();
+      m_Instructions = profiler.Instructions();
+      m_OpCounts = profiler.OpCounts();
+      auto peak = profiler.PeakFrame();
+      lock.unlock();
+
+      auto average = m_Frames > 0 ? m_Instructions / m_Frames : 0;
+
+      ImGui::Text("%llu frames, %llu instructions per frame on average, %llu at most, %u budgeted",
+                  static_cast<unsigned long long>(m_Frames),
+                  static_cast<unsigned long long>(average),
+                  static_cast<unsigned long long>(peak),
+                  bus.CyclesPerFrame());
+
+      if (ImGui::BeginTabBar("profiler")) {
+        if (ImGui::BeginTabItem("Hotspots")) {
+          DrawHotspots(cpu);
+          ImGui::EndTabItem();
+        }
+
+        if (ImGui::BeginTabItem("Opcodes")) {
+          DrawOpClasses();
+          ImGui::EndTabItem();
+        }
+
+        ImGui::EndTabBar();
+      }
+
+      if (!m_Enabled && wasEnabled) {
+        EventManager::Dispatcher().enqueue<Events::SaveAppPrefs>();
+      }
+
+      ImGui::End();
+    }
+  }
+
+  void ProfilerWidget::DrawToolbar(Chip8 &cpu) {
+    auto &bus = Bus::Get();
+    auto &profiler = cpu.GetProfiler();
+
+    auto lock = bus.Lock();
+    bool recording = profiler.Enabled();
+    bool empty = profiler.Instructions() == 0;
+    lock.unlock();
+
+    if (ImGui::Checkbox("Record", &recording)) {
+      lock = bus.Lock();
+      profiler.Enable(recording, cpu.Cycles());
+      lock.unlock();
+
+      m_RefreshCountdown = 0;
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+      lock = bus.Lock();
+      profiler.Clear();
+      lock.unlock();
+
+      m_Hotspots.clear();
+    }
+
+    ImGui::SameLine();
+    ImGui::BeginDisabled(empty);
+    if (ImGui::Button(ICON_FA_SAVE " Export CSV...")) {
+      Export(profiler);
+    }
+    ImGui::EndDisabled();
+  }
+
+  void ProfilerWidget::DrawHotspots(Chip8 &cpu) {
+    auto &bus = Bus::Get();
+
+    if (!ImGui::BeginTable("hotspots", 5, ImGuiTableFlags_ScrollY |
+                                          ImGuiTableFlags_BordersOuterH |
+                                          ImGuiTableFlags_BordersOuterV |
+                                          ImGuiTableFlags_RowBg |
+                                          ImGuiTableFlags_Sortable))
+      return;
+
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Address", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+    ImGui::TableSetupColumn("Instruction", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_NoSort);
+    ImGui::TableSetupColumn("Executions", ImGuiTableColumnFlags_WidthFixed |
+                                          ImGuiTableColumnFlags_DefaultSort |
+                                          ImGuiTableColumnFlags_PreferSortDescending, 90.0f);
+    ImGui::TableSetupColumn("Per Frame", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 70.0f);
+    ImGui::TableSetupColumn("%", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 50.0f);
+    ImGui::TableHeadersRow();
+
+    if (auto *specs = ImGui::TableGetSortSpecs(); specs && specs->SpecsDirty) {
+      if (specs->SpecsCount > 0) {
+        m_SortColumn = specs->Specs[0].ColumnIndex;
+        m_SortAscending = specs->Specs[0].SortDirection == ImGuiSortDirection_Ascending;
+      }
+
+      specs->SpecsDirty = false;
+      m_RefreshCountdown = 0;
+    }
+
+    if (m_RefreshCountdown-- == 0) {
+      auto lock = bus.Lock();
+      Refresh(cpu.GetProfiler());
+      lock.unlock();
+
+      m_RefreshCountdown = 30;
+    }
+
+    auto frames = static_cast<double>(std::max<uint64_t>(m_Frames, 1));
+    auto total = static_cast<double>(std::max<uint64_t>(m_Instructions, 1));
+
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(m_Hotspots.size()));
+
+    // Instruction text for the rows on screen, and whether it came from the disassembly
+    std::vector<std::pair<std::string, bool>> instructions;
+
+    while (clipper.Step()) {
+      instructions.clear();
+
+      auto lock = bus.Lock();
+      const auto &ram = bus.GetRam().GetMemory();
+
+      for (auto row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+        auto addr = m_Hotspots[row].addr;
+        auto line = cpu.DisassemblyRow(addr);
+
+        if (line >= 0) {
+          instructions.emplace_back(cpu.Disassembly()[line].text, true);
+        } else {
+          // Not disassembled, the opcode will have to do
+          instructions.emplace_back(fmt::format("{:02X} {:02X}", ram[addr], ram[(addr + 1) & 0xFFFF]), false);
+        }
+      }
+
+      lock.unlock();
+
+      for (auto row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+        const auto &hotspot = m_Hotspots[row];
+        const auto &[text, disassembled] = instructions[row - clipper.DisplayStart];
+
+        ImGui::TableNextRow();
+
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("$%04X", hotspot.addr);
+
+        ImGui::TableSetColumnIndex(1);
+
+        if (disassembled) {
+          ImGui::TextUnformatted(text.c_str());
+        } else {
+          ImGui::TextDisabled("%s", text.c_str());
+        }
+
+        ImGui::TableSetColumnIndex(2);
+        ImGui::Text("%llu", static_cast<unsigned long long>(hotspot.count));
+
+        ImGui::TableSetColumnIndex(3);
+        ImGui::Text("%.1f", static_cast<double>(hotspot.count) / frames);
+
+        ImGui::TableSetColumnIndex(4);
+        ImGui::Text("%.1f", 100.0 * static_cast<double>(hotspot.count) / total);
+      }
+    }
+
+    ImGui::EndTable();
+  }
+
+  void ProfilerWidget::DrawOpClasses() {
+    const auto &counts = m_OpCounts;
+
+    auto frames = static_cast<double>(std::max<uint64_t>(m_Frames, 1));
+    auto total = static_cast<double>(std::max<uint64_t>(m_Instructions, 1));
+
+    if (!ImGui::BeginTable("opclasses", 4, ImGuiTableFlags_ScrollY |
+                                           ImGuiTableFlags_BordersOuterH |
+                                           ImGuiTableFlags_BordersOuterV |
+                                           ImGuiTableFlags_RowBg))
+      return;
+
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Opcode", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("Executions", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+    ImGui::TableSetupColumn("Per Frame", ImGuiTableColumnFlags_WidthFixed, 70.0f);
+    ImGui::TableSetupColumn("%", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+    ImGui::TableHeadersRow();
+
+    // Only a few dozen classes, sorting them every draw is nothing
+    std::vector<uint8_t> order;
+    for (uint8_t op = 0; op < static_cast<uint8_t>(Chip8::Op::Count); op++) {
+      if (counts[op] > 0)
+        order.push_back(op);
+    }
+
+    std::sort(order.begin(), order.end(), [&counts](uint8_t a, uint8_t b) {
+      return counts[a] > counts[b];
+    });
+
+    for (auto op: order) {
+      ImGui::TableNextRow();
+
+      ImGui::TableSetColumnIndex(0);
+      ImGui::TextUnformatted(Chip8::OpName(static_cast<Chip8::Op>(op)));
+
+      ImGui::TableSetColumnIndex(1);
+      ImGui::Text("%llu", static_cast<unsigned long long>(counts[op]));
+
+      ImGui::TableSetColumnIndex(2);
+      ImGui::Text("%.1f", static_cast<double>(counts[op]) / frames);
+
+      ImGui::TableSetColumnIndex(3);
+      ImGui::Text("%.1f", 100.0 * static_cast<double>(counts[op]) / total);
+    }
+
+    ImGui::EndTable();
+  }
+
+  void ProfilerWidget::Refresh(const Profiler &profiler) {
+    m_Hotspots.clear();
+
+    for (uint32_t addr = 0; addr < 0x10000; addr++) {
+      auto count = profiler.At(static_cast<uint16_t>(addr));
+
+      if (count > 0)
+        m_Hotspots.push_back({static_cast<uint16_t>(addr), count});
+    }
+
+    auto ascending = m_SortAscending;
+
+    if (m_SortColumn == 0) {
+      std::sort(m_Hotspots.begin(), m_Hotspots.end(), [ascending](const Hotspot &a, const Hotspot &b) {
+        return ascending ? a.addr < b.addr : a.addr > b.addr;
+      });
+    } else {
+      std::sort(m_Hotspots.begin(), m_Hotspots.end(), [ascending](const Hotspot &a, const Hotspot &b) {
+        return ascending ? a.count < b.count : a.count > b.count;
+      });
+    }
+  }
+
+  void ProfilerWidget::Export(const Profiler &profiler) {
+    nfdchar_t *outPath = nullptr;
+
+    switch (NFD_SaveDialog("csv", nullptr, &outPath)) {
+      case NFD_OKAY: {
+        // Only once the dialog is gone, the machine stays running behind it
+        auto lock = Bus::Get().Lock();
+        auto error = profiler.SaveCsv(outPath, [](uint8_t op) {
+          return Chip8::OpName(static_cast<Chip8::Op>(op));
+        });
+        lock.unlock();
+        delete outPath;
+
+        if (!error.empty())
+          spdlog::get("console")->error("{}", error);
+      }
+        break;
+
+      case NFD_CANCEL:
+        break;
+
+      case NFD_ERROR:
+        spdlog::get("console")->error("{}", NFD_GetError());
+        break;
+    }
+  }
+} // dorito
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "Widget.h"
+
+namespace dorito {
+
+  class ProfilerWidget : public Widget {
+  public:
+    std::string Name() override {
+      return "Profiler";
+    }
+
+    void Draw() override;
+
+  private:
+    struct Hotspot {
+      uint16_t addr = 0;
+      uint64_t count = 0;
+    };
+
+    void DrawToolbar(Chip8 &cpu);
+
+    void DrawHotspots(Chip8 &cpu);
+
+    void DrawOpClasses();
+
+    // Re-reads the counts, sorted by the table's current sort column
+    void Refresh(const Profiler &profiler);
+
+    void Export(const Profiler &profiler);
+
+  private:
+    std::vector<Hotspot> m_Hotspots;
+
+    // Copied from the profiler at the start of every draw
+    uint64_t m_Frames = 0;
+    uint64_t m_Instructions = 0;
+    std::array<uint64_t, Profiler::OpClasses> m_OpCounts{};
+
+    // Rebuilding the list scans all of memory, only do it every so many draws
+    uint32_t m_RefreshCountdown = 0;
+
+    int16_t m_SortColumn = 2;
+    bool m_SortAscending = false;
+  };
+
+} // dorito
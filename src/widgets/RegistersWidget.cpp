@@ -14,6 +14,21 @@ namespace dorito {
     if (!ImGui::Begin(ICON_FA_MICROCHIP " Registers", &m_Enabled)) {
       ImGui::End();
     } else {
+      // Copied out in one go, the emulation thread keeps running while the rest draws
+      auto lock = bus.Lock();
+
+      auto regs = cpu.regs;
+      auto cycles = cpu.Cycles();
+      std::vector<std::pair<std::string, uint16_t>> operands;
+      std::vector<uint16_t> stack(bus.GetRam().GetStack().begin(), bus.GetRam().GetStack().end());
+
+      if (cpu.m_CurrentInstruction) {
+        for (auto i = 0; i < cpu.m_CurrentInstruction->operand_count; i++) {
+          operands.emplace_back(cpu.OperandTypeName(cpu.mOperands[i].type), cpu.mOperands[i].value);
+        }
+      }
+
+      lock.unlock();
 
       ImGui::BeginTable("flagsbtnscycles", 2);
       ImGui::TableSetupColumn("btns");
@@ -29,13 +44,19 @@ namespace dorito {
       ImGui::SameLine();
 
       if (!bus.Running()) {
+        if (ImGui::Button(ICON_FA_STEP_BACKWARD " Back")) {
+          EventManager::Dispatcher().enqueue<Events::StepBackCPU>({});
+        }
+
+        ImGui::SameLine();
+
         if (ImGui::Button(ICON_FA_STEP_FORWARD " Step")) {
           EventManager::Dispatcher().enqueue<Events::StepCPU>({});
         }
       }
 
       ImGui::TableSetColumnIndex(1);
-      auto cycleInfo = fmt::format("Total Cycles: {}", cpu.m_Cycles);
+      auto cycleInfo = fmt::format("Total Cycles: {}", cycles);
       auto posX = (ImGui::GetCursorPosX() + ImGui::GetColumnWidth() - ImGui::CalcTextSize(cycleInfo.c_str()).x
                    - ImGui::GetScrollX() - 2 * ImGui::GetStyle().ItemSpacing.x);
       if (posX > ImGui::GetCursorPosX())
@@ -48,12 +69,20 @@ namespace dorito {
 
       if (!bus.Running()) {
         static uint16_t addr = 0x200;
+        static uint32_t budget = 100;
 
         ImGui::Text("Run to Address:");
         ImGui::SameLine();
         ImGui::InputScalar("##", ImGuiDataType_U16, &addr, nullptr, nullptr, "0x%04X");
-        if (ImGui::Button("Go...")) {
-          EventManager::Dispatcher().enqueue<Events::ExecuteUntil>({addr});
+
+        // In millions of instructions, gives up rather than spinning forever on an address never reached
+        ImGui::Text("Give up after:");
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(80.0f);
+        ImGui::InputScalar("M instructions##budget", ImGuiDataType_U32, &budget);
+
+        if (ImGui::Button("Go...") && budget > 0) {
+          EventManager::Dispatcher().enqueue<Events::ExecuteUntil>({addr, uint64_t{budget} * 1'000'000});
         }
       }
 
@@ -67,13 +96,13 @@ namespace dorito {
       ImGui::TableNextRow();
 
       ImGui::TableSetColumnIndex(0);
-      ImGui::TextUnformatted(fmt::format("0x{:04X}", cpu.regs.pc).c_str());
+      ImGui::TextUnformatted(fmt::format("0x{:04X}", regs.pc).c_str());
 
       ImGui::TableSetColumnIndex(1);
-      ImGui::TextUnformatted(fmt::format("0x{:04X}", cpu.regs.i).c_str());
+      ImGui::TextUnformatted(fmt::format("0x{:04X}", regs.i).c_str());
 
       ImGui::TableSetColumnIndex(2);
-      ImGui::TextUnformatted(fmt::format("0x{:04X}", cpu.regs.latch).c_str());
+      ImGui::TextUnformatted(fmt::format("0x{:04X}", regs.latch).c_str());
 
 
       ImGui::EndTable();
@@ -85,10 +114,10 @@ namespace dorito {
       ImGui::TableNextRow();
 
       ImGui::TableSetColumnIndex(0);
-      ImGui::TextUnformatted(fmt::format("0x{:02X}", cpu.regs.dt).c_str());
+      ImGui::TextUnformatted(fmt::format("0x{:02X}", regs.dt).c_str());
 
       ImGui::TableSetColumnIndex(1);
-      ImGui::TextUnformatted(fmt::format("0x{:02X}", cpu.regs.st).c_str());
+      ImGui::TextUnformatted(fmt::format("0x{:02X}", regs.st).c_str());
 
       ImGui::EndTable();
 
@@ -107,7 +136,7 @@ namespace dorito {
       ImGui::TableNextRow();
       for (auto r = 0; r < 8; r++) {
         ImGui::TableSetColumnIndex(r);
-        ImGui::TextUnformatted(fmt::format("0x{:02X}", cpu.regs.v[r]).c_str());
+        ImGui::TextUnformatted(fmt::format("0x{:02X}", regs.v[r]).c_str());
       }
 
       ImGui::EndTable();
@@ -127,7 +156,7 @@ namespace dorito {
       ImGui::TableNextRow();
       for (auto r = 8; r < 16; r++) {
         ImGui::TableSetColumnIndex(r - 8);
-        ImGui::TextUnformatted(fmt::format("0x{:02X}", cpu.regs.v[r]).c_str());
+        ImGui::TextUnformatted(fmt::format("0x{:02X}", regs.v[r]).c_str());
       }
 
       ImGui::EndTable();
@@ -146,15 +175,12 @@ namespace dorito {
       ImGui::TableSetupColumn("OpType", ImGuiTableColumnFlags_None);
       ImGui::TableSetupColumn("OpValue", ImGuiTableColumnFlags_None);
 
-      if (cpu.m_CurrentInstruction) {
-        for (auto i = 0; i < cpu.m_CurrentInstruction->operand_count; i++) {
-          ImGui::TableNextRow();
-          auto &op = cpu.mOperands[i];
-          ImGui::TableSetColumnIndex(0);
-          ImGui::Text("%s", cpu.OperandTypeName(op.type).c_str());
-          ImGui::TableSetColumnIndex(1);
-          ImGui::Text("0x%X (%d)", op.value, op.value);
-        }
+      for (const auto &[type, value]: operands) {
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("%s", type.c_str());
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Text("0x%X (%d)", value, value);
       }
 
       ImGui::EndTable();
@@ -164,7 +190,7 @@ namespace dorito {
       ImGui::BeginTable("stack", 1, ImGuiTableFlags_RowBg);
       ImGui::TableSetupColumn("address", ImGuiTableColumnFlags_None);
 
-      for (const auto &item: bus.GetRam().GetStack()) {
+      for (auto item: stack) {
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("0x%X", item);
@@ -203,7 +203,7 @@ namespace dorito {
 
   void SoundEditorWidget::PatternEditor() {
     auto &bus = Bus::Get();
-    auto &palette = bus.GetDisplay().Palette();
+    auto &palette = bus.Palette();
 
     ImGuiIO &io = ImGui::GetIO();
     ImDrawList *draw_list = ImGui::GetWindowDrawList();
@@ -342,7 +342,7 @@ namespace dorito {
 
   void SoundEditorWidget::TonePattern() {
     auto &bus = Bus::Get();
-    auto &palette = bus.GetDisplay().Palette();
+    auto &palette = bus.Palette();
 
     ImGuiIO &io = ImGui::GetIO();
     ImDrawList *draw_list = ImGui::GetWindowDrawList();
@@ -128,7 +128,7 @@ namespace dorito {
 
   void SpriteEditorWidget::ColorChooser() {
     auto &bus = Bus::Get();
-    auto &palette = bus.GetDisplay().Palette();
+    auto &palette = bus.Palette();
 
     if (colorSprite) {
       ImGui::Separator();
@@ -213,7 +213,7 @@ namespace dorito {
 
   void SpriteEditorWidget::SpriteCanvas() {
     auto &bus = Bus::Get();
-    auto &palette = bus.GetDisplay().Palette();
+    auto &palette = bus.Palette();
 
     ImGuiIO &io = ImGui::GetIO();
     ImDrawList *draw_list = ImGui::GetWindowDrawList();
@@ -0,0 +1,407 @@
+#include "TraceWidget.h"
+
+#include <cctype>
+
+#include <nfd.h>
+
+#include "layers/UI.h"
+
+namespace dorito {
+  void TraceWidget::Draw() {
+    auto &bus = Bus::Get();
+    auto &tracer = bus.GetCpu().GetTracer();
+
+    bool wasEnabled = m_Enabled;
+
+    ImGui::SetNextWindowSize({500, 400}, ImGuiCond_FirstUseEver);
+
+    if (!ImGui::Begin(ICON_FA_LIST " Trace", &m_Enabled)) {
+      ImGui::End();
+    } else {
+      DrawToolbar(tracer);
+
+      std::function<const TraceEntry &(uint32_t)> entryAt;
+      uint32_t size;
+      uint64_t version;
+
+      // Only the live trace is the machine's, a loaded one is ours to read freely
+      auto lockLive = [this, &bus] {
+        return m_ShowLoaded ? std::unique_lock<std::recursive_mutex>{} : bus.Lock();
+      };
+
+      auto lock = lockLive();
+
+      if (m_ShowLoaded) {
+        entryAt = [this](uint32_t index) -> const TraceEntry & { return m_Loaded[index]; };
+        size = static_cast<uint32_t>(m_Loaded.size());
+        version = 0;
+      } else {
+        entryAt = [&tracer](uint32_t index) -> const TraceEntry & { return tracer.At(index); };
+        size = tracer.Size();
+        version = tracer.Recorded();
+      }
+
+      // Only while recording does the live trace change under us
+      if (m_Dirty || version != m_FilteredAt) {
+        Refilter(size, entryAt);
+        m_FilteredAt = version;
+        m_Dirty = false;
+      }
+
+      if (lock)
+        lock.unlock();
+
+      bool filtered = m_OnlyMatches && Querying();
+      auto rows = filtered ? static_cast<uint32_t>(m_Matches.size()) : size;
+
+      if (Querying()) {
+        ImGui::Text("%u of %u entries match", static_cast<uint32_t>(m_Matches.size()), size);
+      } else {
+        ImGui::Text("%u entries", size);
+      }
+
+      if (ImGui::BeginTable("trace", 5, ImGuiTableFlags_ScrollY |
+                                        ImGuiTableFlags_BordersOuterH |
+                                        ImGuiTableFlags_BordersOuterV |
+                                        ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Cycle", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+        ImGui::TableSetupColumn("PC", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+        ImGui::TableSetupColumn("Opcode", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+        ImGui::TableSetupColumn("I", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+        ImGui::TableSetupColumn("Changed", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableHeadersRow();
+
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(rows));
+
+        std::vector<TraceEntry> visible;
+
+        while (clipper.Step()) {
+          visible.clear();
+
+          // Recording keeps going underneath, so copy out just the rows on screen
+          lock = lockLive();
+          for (auto row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            auto index = filtered ? m_Matches[row] : static_cast<uint32_t>(row);
+
+            // A reset may have cleared the live trace since, those rows go blank for a draw
+            visible.push_back(m_ShowLoaded || index < tracer.Size() ? entryAt(index) : TraceEntry{});
+          }
+
+          if (lock)
+            lock.unlock();
+
+          for (auto row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            auto index = filtered ? m_Matches[row] : static_cast<uint32_t>(row);
+            const auto &entry = visible[row - clipper.DisplayStart];
+
+            ImGui::TableNextRow();
+
+            if (static_cast<int32_t>(index) == m_Selected) {
+              ImU32 color = ImGui::GetColorU32(ImVec4(0.18f, 0.47f, 0.59f, 0.65f));
+              ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg1, color);
+            } else if (!filtered && Querying() && Matches(entry)) {
+              ImU32 color = ImGui::GetColorU32(ImVec4(0.47f, 0.40f, 0.10f, 0.45f));
+              ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg1, color);
+            }
+
+            ImGui::TableSetColumnIndex(0);
+            ImGui::PushID(row);
+            if (ImGui::Selectable(fmt::format("{}", entry.cycle).c_str(), false,
+                                  ImGuiSelectableFlags_SpanAllColumns)) {
+              m_Selected = static_cast<int32_t>(index);
+            }
+            ImGui::PopID();
+
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("$%04X", entry.pc);
+
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%04X", entry.opcode);
+
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("$%04X", entry.i);
+
+            ImGui::TableSetColumnIndex(4);
+            std::string changed;
+            for (uint8_t n = 0; n < 16; n++) {
+              if ((entry.changed >> n) & 1)
+                changed += fmt::format("v{:X}={:02X} ", n, entry.v[n]);
+            }
+            ImGui::TextUnformatted(changed.c_str());
+          }
+        }
+
+        if (m_ScrollToSelected && m_Selected >= 0) {
+          int64_t row = m_Selected;
+
+          if (filtered) {
+            auto it = std::lower_bound(m_Matches.begin(), m_Matches.end(), static_cast<uint32_t>(m_Selected));
+            row = it - m_Matches.begin();
+          }
+
+          ImGui::SetScrollY(clipper.ItemsHeight * static_cast<float>(row) - ImGui::GetWindowHeight() / 2);
+          m_ScrollToSelected = false;
+        }
+
+        ImGui::EndTable();
+      }
+
+      if (!m_Enabled && wasEnabled) {
+        EventManager::Dispatcher().enqueue<Events::SaveAppPrefs>();
+      }
+
+      ImGui::End();
+    }
+  }
+
+  void TraceWidget::DrawToolbar(Tracer &tracer) {
+    static const std::pair<const char *, uint32_t> capacities[] = {
+        {"64K",  1 << 16},
+        {"256K", 1 << 18},
+        {"1M",   1 << 20},
+        {"4M",   1 << 22}
+    };
+
+    auto &bus = Bus::Get();
+
+    auto lock = bus.Lock();
+    bool recording = tracer.Enabled();
+    bool empty = tracer.Size() == 0;
+    lock.unlock();
+
+    if (ImGui::Checkbox("Record", &recording)) {
+      lock = bus.Lock();
+      tracer.Enable(recording, m_Capacity);
+      lock.unlock();
+
+      m_Selected = -1;
+      m_Dirty = true;
+    }
+
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(70.0f);
+
+    const char *current = "";
+    for (const auto &[label, capacity]: capacities) {
+      if (capacity == m_Capacity)
+        current = label;
+    }
+
+    if (ImGui::BeginCombo("Entries", current)) {
+      for (const auto &[label, capacity]: capacities) {
+        if (ImGui::Selectable(label, capacity == m_Capacity)) {
+          m_Capacity = capacity;
+
+          lock = bus.Lock();
+          if (tracer.Enabled())
+            tracer.Enable(true, m_Capacity);
+          lock.unlock();
+
+          m_Dirty = true;
+        }
+      }
+
+      ImGui::EndCombo();
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+      lock = bus.Lock();
+      tracer.Clear();
+      lock.unlock();
+
+      m_Selected = -1;
+      m_Dirty = true;
+    }
+
+    ImGui::SameLine();
+    ImGui::BeginDisabled(empty);
+    if (ImGui::Button(ICON_FA_SAVE " Export...")) {
+      Export(tracer);
+    }
+    ImGui::EndDisabled();
+
+    ImGui::SameLine();
+    if (ImGui::Button(ICON_FA_FOLDER_OPEN " Import...")) {
+      Import();
+    }
+
+    if (m_ShowLoaded) {
+      ImGui::SameLine();
+      if (ImGui::Button("Back to Live")) {
+        m_ShowLoaded = false;
+        m_Loaded.clear();
+        m_Selected = -1;
+        m_Dirty = true;
+      }
+    }
+
+    bool changed = false;
+
+    ImGui::SetNextItemWidth(100.0f);
+    changed |= ImGui::InputTextWithHint("Address", "200-2FF", m_AddressQuery.data(), m_AddressQuery.size(),
+                                        ImGuiInputTextFlags_CharsNoBlank);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(60.0f);
+    changed |= ImGui::InputTextWithHint("Opcode", "D??5", m_OpcodeQuery.data(), m_OpcodeQuery.size(),
+                                        ImGuiInputTextFlags_CharsNoBlank);
+    ImGui::SameLine();
+    changed |= ImGui::Checkbox("Only matches", &m_OnlyMatches);
+
+    if (changed) {
+      m_QueryValid = ParseQuery();
+      m_Dirty = true;
+    }
+
+    if (!m_QueryValid) {
+      ImGui::SameLine();
+      ImGui::TextColored({1.0f, 0.4f, 0.4f, 1.0f}, "Bad query");
+    }
+
+    ImGui::SameLine();
+    if (ImGui::ArrowButton("##prev", ImGuiDir_Up) && !m_Matches.empty()) {
+      auto it = std::lower_bound(m_Matches.begin(), m_Matches.end(), static_cast<uint32_t>(std::max(m_Selected, 0)));
+      m_Selected = static_cast<int32_t>(it == m_Matches.begin() ? m_Matches.back() : *(it - 1));
+      m_ScrollToSelected = true;
+    }
+
+    ImGui::SameLine();
+    if (ImGui::ArrowButton("##next", ImGuiDir_Down) && !m_Matches.empty()) {
+      auto it = std::upper_bound(m_Matches.begin(), m_Matches.end(), static_cast<uint32_t>(m_Selected));
+      m_Selected = static_cast<int32_t>(it == m_Matches.end() ? m_Matches.front() : *it);
+      m_ScrollToSelected = true;
+    }
+  }
+
+  bool TraceWidget::ParseQuery() {
+    m_AddressFrom = 0;
+    m_AddressTo = 0xFFFF;
+    m_OpcodeValue = 0;
+    m_OpcodeMask = 0;
+
+    auto parseAddress = [](const std::string &text, uint16_t &addr) {
+      if (text.empty() || text.size() > 4)
+        return false;
+
+      for (char c: text) {
+        if (!std::isxdigit(static_cast<unsigned char>(c)))
+          return false;
+      }
+
+      addr = static_cast<uint16_t>(std::stoul(text, nullptr, 16));
+      return true;
+    };
+
+    std::string address{m_AddressQuery.data()};
+
+    if (!address.empty()) {
+      auto dash = address.find('-');
+
+      if (dash == std::string::npos) {
+        if (!parseAddress(address, m_AddressFrom))
+          return false;
+
+        m_AddressTo = m_AddressFrom;
+      } else if (!parseAddress(address.substr(0, dash), m_AddressFrom) ||
+                 !parseAddress(address.substr(dash + 1), m_AddressTo)) {
+        return false;
+      }
+    }
+
+    // One nibble per character, ? matches anything
+    std::string opcode{m_OpcodeQuery.data()};
+
+    if (opcode.size() > 4)
+      return false;
+
+    for (size_t n = 0; n < opcode.size(); n++) {
+      auto shift = static_cast<uint8_t>(12 - 4 * n);
+      char c = opcode[n];
+
+      if (c == '?')
+        continue;
+
+      if (!std::isxdigit(static_cast<unsigned char>(c)))
+        return false;
+
+      m_OpcodeValue |= static_cast<uint16_t>(std::stoi(std::string{c}, nullptr, 16) << shift);
+      m_OpcodeMask |= static_cast<uint16_t>(0xF << shift);
+    }
+
+    return true;
+  }
+
+  bool TraceWidget::Matches(const TraceEntry &entry) const {
+    return entry.pc >= m_AddressFrom && entry.pc <= m_AddressTo &&
+           (entry.opcode & m_OpcodeMask) == m_OpcodeValue;
+  }
+
+  void TraceWidget::Refilter(uint32_t size, const std::function<const TraceEntry &(uint32_t)> &entryAt) {
+    m_Matches.clear();
+
+    // Everything matches an empty query, no need to list it all
+    if (!m_QueryValid || !Querying())
+      return;
+
+    for (uint32_t index = 0; index < size; index++) {
+      if (Matches(entryAt(index)))
+        m_Matches.push_back(index);
+    }
+  }
+
+  void TraceWidget::Export(const Tracer &tracer) {
+    nfdchar_t *outPath = nullptr;
+
+    switch (NFD_SaveDialog("dtrace", nullptr, &outPath)) {
+      case NFD_OKAY: {
+        // Only once the dialog is gone, the machine stays running behind it
+        auto lock = Bus::Get().Lock();
+        auto error = tracer.Save(outPath);
+        lock.unlock();
+        delete outPath;
+
+        if (!error.empty())
+          spdlog::get("console")->error("{}", error);
+      }
+        break;
+
+      case NFD_CANCEL:
+        break;
+
+      case NFD_ERROR:
+        spdlog::get("console")->error("{}", NFD_GetError());
+        break;
+    }
+  }
+
+  void TraceWidget::Import() {
+    nfdchar_t *outPath = nullptr;
+
+    switch (NFD_OpenDialog("dtrace", nullptr, &outPath)) {
+      case NFD_OKAY: {
+        auto error = Tracer::Load(outPath, m_Loaded);
+        delete outPath;
+
+        if (!error.empty()) {
+          spdlog::get("console")->error("{}", error);
+          m_Loaded.clear();
+          break;
+        }
+
+        m_ShowLoaded = true;
+        m_Selected = -1;
+        m_Dirty = true;
+      }
+        break;
+
+      case NFD_CANCEL:
+        break;
+
+      case NFD_ERROR:
+        spdlog::get("console")->error("{}", NFD_GetError());
+        break;
+    }
+  }
+} // dorito
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <vector>
+
+#include "Widget.h"
+
+namespace dorito {
+
+  class TraceWidget : public Widget {
+  public:
+    std::string Name() override {
+      return "Trace";
+    }
+
+    void Draw() override;
+
+  private:
+    void DrawToolbar(Tracer &tracer);
+
+    void Export(const Tracer &tracer);
+
+    void Import();
+
+    // Reads the query boxes, false when one of them doesn't parse
+    bool ParseQuery();
+
+    [[nodiscard]] bool Matches(const TraceEntry &entry) const;
+
+    [[nodiscard]] bool Querying() const {
+      return m_OpcodeMask != 0 || m_AddressFrom != 0 || m_AddressTo != 0xFFFF;
+    }
+
+    void Refilter(uint32_t size, const std::function<const TraceEntry &(uint32_t)> &entryAt);
+
+  private:
+    // A loaded dump replaces the live trace until it's closed
+    std::vector<TraceEntry> m_Loaded;
+    bool m_ShowLoaded = false;
+
+    std::array<char, 16> m_AddressQuery{};
+    std::array<char, 8> m_OpcodeQuery{};
+    bool m_OnlyMatches = true;
+
+    uint16_t m_AddressFrom = 0;
+    uint16_t m_AddressTo = 0xFFFF;
+    uint16_t m_OpcodeValue = 0;
+    uint16_t m_OpcodeMask = 0;
+    bool m_QueryValid = true;
+
+    // Indices of the entries matching the query, into whichever trace is on screen
+    std::vector<uint32_t> m_Matches;
+    uint64_t m_FilteredAt = UINT64_MAX;
+    bool m_Dirty = true;
+
+    uint32_t m_Capacity = Tracer::DefaultCapacity;
+
+    int32_t m_Selected = -1;
+    bool m_ScrollToSelected = false;
+  };
+
+} // dorito
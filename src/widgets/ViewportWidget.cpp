@@ -83,6 +83,14 @@ namespace dorito {
         m_PrevScreenHeight = windowHeight;
       }
 
+      // Held backspace rewinds, unless it's deleting text somewhere
+      bool rewinding = IsKeyDown(KEY_BACKSPACE) && ImGui::IsWindowFocused() && !ImGui::GetIO().WantTextInput;
+
+      if (rewinding != m_Rewinding) {
+        m_Rewinding = rewinding;
+        EventManager::Dispatcher().enqueue<Events::RewindCPU>({rewinding});
+      }
+
       ImGui::End();
     }
 
@@ -32,6 +32,8 @@ namespace dorito {
     int32_t m_PrevScreenHeight;
 
     bool m_Enabled = true;
+
+    bool m_Rewinding = false;
   };
 
 } // dorito
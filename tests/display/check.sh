@@ -0,0 +1,11 @@
+#!/bin/sh
+# Runs display.jobs and compares every frame hash against expected.csv,
+# recorded with the per-pixel drawing code before the planes were packed.
+# Usage: check.sh path/to/dorito_batch
+set -e
+
+batch=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+cd "$(dirname "$0")"
+
+# Drop the last column, the wall clock time
+"$batch" --jobs display.jobs | cut -d, -f1-14 | diff -u expected.csv -